@@ -67,6 +67,13 @@ b.suite(
       e.map(array, 'x', r);
     };
   }),
+  b.add(`jeetah map() { precision: 'vector' }`, () => {
+    const e = new expr(fn, { precision: 'vector' });
+    return () => {
+      // This is the bench
+      e.map(array, 'x', r);
+    };
+  }),
   b.cycle(),
   b.complete(),
   b.save({
@@ -6,7 +6,7 @@
   'target_defaults': {
     'cflags!': [ '-fno-exceptions', '-fno-rtti', '-fvisibility=default' ],
     'cflags_cc!': [ '-fno-exceptions', '-fno-rtti', '-fvisibility=default' ],
-    'cflags_cc': [ '-fvisibility=hidden', '-std=c++14' ],
+    'cflags_cc': [ '-fvisibility=hidden', '-std=c++14', '-ffp-contract=off', '-fno-math-errno' ],
     'ldflags': [ '-Wl,-z,now' ],
     'xcode_settings': {
       'GCC_ENABLE_CPP_EXCEPTIONS': 'YES',
@@ -15,7 +15,9 @@
 			'OTHER_CPLUSPLUSFLAGS': [
 				'-frtti',
 				'-fexceptions',
-        '-std=c++14'
+        '-std=c++14',
+        '-ffp-contract=off',
+        '-fno-math-errno'
 			]
     },
     'msvs_settings': {
@@ -67,19 +69,27 @@
     {
       'target_name': 'jeetah',
       'sources': [
-        'src/jeetah.cc'
+        'src/jeetah.cc',
+        'src/kernel.cc',
+        'src/vector.cc',
+        'src/kernels.cc',
+        'src/cpu.cc'
       ],
       'include_dirs': [
         '<!@(node -p "require(\'node-addon-api\').include")'
       ],
       'defines': [
-        'NAPI_VERSION=4',
+        'NAPI_VERSION=6',
       ],
       'dependencies': [
         '<!(node -p "require(\'node-addon-api\').gyp")',
         'deps/mir.gyp:mir'
       ],
       'conditions': [
+        ['target_arch == "x64"', {
+          'defines': [ 'JEETAH_X64' ],
+          'dependencies': [ 'kernels_avx2', 'kernels_avx512' ]
+        }],
         ['enable_asan == "true"', {
           'cflags_cc': [ '-fsanitize=address' ],
           'ldflags' : [ '-fsanitize=address' ],
@@ -91,6 +101,10 @@
         ["enable_coverage == 'true'", {
           'cflags_cc': [ '-fprofile-arcs', '-ftest-coverage' ],
           'ldflags' : [ '-lgcov', '--coverage' ]
+        }],
+        # libmvec is opened at run time
+        ['OS == "linux"', {
+          'libraries': [ '-ldl' ]
         }]
       ]
     },
@@ -107,5 +121,42 @@
         }
       ]
     }
+  ],
+  'conditions': [
+    # The vector kernels built for newer CPUs, src/cpu.cc picks one at load time
+    ['target_arch == "x64"', {
+      'targets': [
+        {
+          'target_name': 'kernels_avx2',
+          'type': 'static_library',
+          'sources': [ 'src/kernels-avx2.cc' ],
+          'defines': [ 'JEETAH_X64' ],
+          'cflags_cc': [ '-mavx2', '-mfma' ],
+          'xcode_settings': {
+            'OTHER_CPLUSPLUSFLAGS': [ '-mavx2', '-mfma' ]
+          },
+          'msvs_settings': {
+            'VCCLCompilerTool': {
+              'AdditionalOptions': [ '/arch:AVX2' ]
+            }
+          }
+        },
+        {
+          'target_name': 'kernels_avx512',
+          'type': 'static_library',
+          'sources': [ 'src/kernels-avx512.cc' ],
+          'defines': [ 'JEETAH_X64' ],
+          'cflags_cc': [ '-mavx2', '-mfma', '-mavx512f', '-mavx512dq', '-mprefer-vector-width=512' ],
+          'xcode_settings': {
+            'OTHER_CPLUSPLUSFLAGS': [ '-mavx2', '-mfma', '-mavx512f', '-mavx512dq', '-mprefer-vector-width=512' ]
+          },
+          'msvs_settings': {
+            'VCCLCompilerTool': {
+              'AdditionalOptions': [ '/arch:AVX512' ]
+            }
+          }
+        }
+      ]
+    }]
   ]
 }
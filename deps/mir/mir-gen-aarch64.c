@@ -9,6 +9,7 @@ static void fancy_abort (int code) {
 #define gen_assert(c) fancy_abort (c)
 
 #include <limits.h>
+#include <math.h>
 
 #define HREG_EL(h) h##_HARD_REG
 #define REP_SEP ,
@@ -27,8 +28,12 @@ enum {
 
 static const MIR_reg_t MAX_HARD_REG = V31_HARD_REG;
 static const MIR_reg_t FP_HARD_REG = R29_HARD_REG;
+
 static const MIR_reg_t LINK_HARD_REG = R30_HARD_REG;
 
+/* No conditional select yet, the select insns become branches: */
+static const int target_sel_p = FALSE;
+
 static int target_locs_num (MIR_reg_t loc, MIR_type_t type) {
   return loc > MAX_HARD_REG && type == MIR_T_LD ? 2 : 1;
 }
@@ -552,6 +557,38 @@ static long double mir_ldneg (long double d) { return -d; }
 static const char *LDNEG = "mir.ldneg";
 static const char *LDNEG_P = "mir.ldneg.p";
 
+/* Rounding, square root and absolute value are library calls */
+static float mir_fsqrt (float f) { return sqrtf (f); }
+static double mir_dsqrt (double d) { return sqrt (d); }
+static float mir_fabs (float f) { return fabsf (f); }
+static double mir_dabs (double d) { return fabs (d); }
+static float mir_ffloor (float f) { return floorf (f); }
+static double mir_dfloor (double d) { return floor (d); }
+static float mir_fceil (float f) { return ceilf (f); }
+static double mir_dceil (double d) { return ceil (d); }
+static float mir_ftrunc (float f) { return truncf (f); }
+static double mir_dtrunc (double d) { return trunc (d); }
+static const char *FSQRT = "mir.fsqrt";
+static const char *FSQRT_P = "mir.fsqrt.p";
+static const char *DSQRT = "mir.dsqrt";
+static const char *DSQRT_P = "mir.dsqrt.p";
+static const char *FABS = "mir.fabs";
+static const char *FABS_P = "mir.fabs.p";
+static const char *DABS = "mir.dabs";
+static const char *DABS_P = "mir.dabs.p";
+static const char *FFLOOR = "mir.ffloor";
+static const char *FFLOOR_P = "mir.ffloor.p";
+static const char *DFLOOR = "mir.dfloor";
+static const char *DFLOOR_P = "mir.dfloor.p";
+static const char *FCEIL = "mir.fceil";
+static const char *FCEIL_P = "mir.fceil.p";
+static const char *DCEIL = "mir.dceil";
+static const char *DCEIL_P = "mir.dceil.p";
+static const char *FTRUNC = "mir.ftrunc";
+static const char *FTRUNC_P = "mir.ftrunc.p";
+static const char *DTRUNC = "mir.dtrunc";
+static const char *DTRUNC_P = "mir.dtrunc.p";
+
 static const char *VA_ARG_P = "mir.va_arg.p";
 static const char *VA_ARG = "mir.va_arg";
 static const char *VA_BLOCK_ARG_P = "mir.va_block_arg.p";
@@ -696,6 +733,66 @@ static int get_builtin (gen_ctx_t gen_ctx, MIR_insn_code_t code, MIR_item_t *pro
                                       MIR_T_LD, "d1", MIR_T_LD, "d2");
     *func_import_item = _MIR_builtin_func (ctx, curr_func_item->module, LDLE, mir_ldle);
     return 2;
+  case MIR_FSQRT:
+    res_type = MIR_T_F;
+    *proto_item
+      = _MIR_builtin_proto (ctx, curr_func_item->module, FSQRT_P, 1, &res_type, 1, MIR_T_F, "f");
+    *func_import_item = _MIR_builtin_func (ctx, curr_func_item->module, FSQRT, mir_fsqrt);
+    return 1;
+  case MIR_DSQRT:
+    res_type = MIR_T_D;
+    *proto_item
+      = _MIR_builtin_proto (ctx, curr_func_item->module, DSQRT_P, 1, &res_type, 1, MIR_T_D, "d");
+    *func_import_item = _MIR_builtin_func (ctx, curr_func_item->module, DSQRT, mir_dsqrt);
+    return 1;
+  case MIR_FABS:
+    res_type = MIR_T_F;
+    *proto_item
+      = _MIR_builtin_proto (ctx, curr_func_item->module, FABS_P, 1, &res_type, 1, MIR_T_F, "f");
+    *func_import_item = _MIR_builtin_func (ctx, curr_func_item->module, FABS, mir_fabs);
+    return 1;
+  case MIR_DABS:
+    res_type = MIR_T_D;
+    *proto_item
+      = _MIR_builtin_proto (ctx, curr_func_item->module, DABS_P, 1, &res_type, 1, MIR_T_D, "d");
+    *func_import_item = _MIR_builtin_func (ctx, curr_func_item->module, DABS, mir_dabs);
+    return 1;
+  case MIR_FFLOOR:
+    res_type = MIR_T_F;
+    *proto_item
+      = _MIR_builtin_proto (ctx, curr_func_item->module, FFLOOR_P, 1, &res_type, 1, MIR_T_F, "f");
+    *func_import_item = _MIR_builtin_func (ctx, curr_func_item->module, FFLOOR, mir_ffloor);
+    return 1;
+  case MIR_DFLOOR:
+    res_type = MIR_T_D;
+    *proto_item
+      = _MIR_builtin_proto (ctx, curr_func_item->module, DFLOOR_P, 1, &res_type, 1, MIR_T_D, "d");
+    *func_import_item = _MIR_builtin_func (ctx, curr_func_item->module, DFLOOR, mir_dfloor);
+    return 1;
+  case MIR_FCEIL:
+    res_type = MIR_T_F;
+    *proto_item
+      = _MIR_builtin_proto (ctx, curr_func_item->module, FCEIL_P, 1, &res_type, 1, MIR_T_F, "f");
+    *func_import_item = _MIR_builtin_func (ctx, curr_func_item->module, FCEIL, mir_fceil);
+    return 1;
+  case MIR_DCEIL:
+    res_type = MIR_T_D;
+    *proto_item
+      = _MIR_builtin_proto (ctx, curr_func_item->module, DCEIL_P, 1, &res_type, 1, MIR_T_D, "d");
+    *func_import_item = _MIR_builtin_func (ctx, curr_func_item->module, DCEIL, mir_dceil);
+    return 1;
+  case MIR_FTRUNC:
+    res_type = MIR_T_F;
+    *proto_item
+      = _MIR_builtin_proto (ctx, curr_func_item->module, FTRUNC_P, 1, &res_type, 1, MIR_T_F, "f");
+    *func_import_item = _MIR_builtin_func (ctx, curr_func_item->module, FTRUNC, mir_ftrunc);
+    return 1;
+  case MIR_DTRUNC:
+    res_type = MIR_T_D;
+    *proto_item
+      = _MIR_builtin_proto (ctx, curr_func_item->module, DTRUNC_P, 1, &res_type, 1, MIR_T_D, "d");
+    *func_import_item = _MIR_builtin_func (ctx, curr_func_item->module, DTRUNC, mir_dtrunc);
+    return 1;
   case MIR_VA_ARG:
     res_type = MIR_T_I64;
     *proto_item = _MIR_builtin_proto (ctx, curr_func_item->module, VA_ARG_P, 1, &res_type, 2,
@@ -873,6 +970,10 @@ static void target_machinize (gen_ctx_t gen_ctx) {
 
     next_insn = DLIST_NEXT (MIR_insn_t, insn);
     code = insn->code;
+    if (code == MIR_FFMA || code == MIR_DFMA) { /* no fused multiply-add yet */
+      split_fma_insn (gen_ctx, insn);
+      continue;
+    }
     if (code == MIR_LDBEQ || code == MIR_LDBNE || code == MIR_LDBLT || code == MIR_LDBGE
         || code == MIR_LDBGT || code == MIR_LDBLE) {
       temp_op = MIR_new_reg_op (ctx, gen_new_temp_reg (gen_ctx, MIR_T_I64, func));
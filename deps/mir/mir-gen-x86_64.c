@@ -3,6 +3,12 @@
 */
 
 #include <limits.h>
+#include <math.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
 
 #define HREG_EL(h) h##_HARD_REG
 #define REP_SEP ,
@@ -18,6 +24,9 @@ enum {
 static const MIR_reg_t MAX_HARD_REG = ST1_HARD_REG;
 static const MIR_reg_t FP_HARD_REG = BP_HARD_REG;
 
+/* The select insns are generated with cmov: */
+static const int target_sel_p = TRUE;
+
 static int target_locs_num (MIR_reg_t loc, MIR_type_t type) {
   return loc > MAX_HARD_REG && type == MIR_T_LD ? 2 : 1;
 }
@@ -115,7 +124,8 @@ static const MIR_insn_code_t target_io_dup_op_insn_codes[] = {
   MIR_DIVS,  MIR_UDIV,  MIR_FDIV,  MIR_DDIV, MIR_LDDIV, MIR_MOD,        MIR_MODS,
   MIR_UMOD,  MIR_UMODS, MIR_AND,   MIR_ANDS, MIR_OR,    MIR_ORS,        MIR_XOR,
   MIR_XORS,  MIR_LSH,   MIR_LSHS,  MIR_RSH,  MIR_RSHS,  MIR_URSH,       MIR_URSHS,
-  MIR_NEG,   MIR_NEGS,  MIR_FNEG,  MIR_DNEG, MIR_LDNEG, MIR_INSN_BOUND,
+  MIR_NEG,   MIR_NEGS,  MIR_FNEG,  MIR_DNEG, MIR_LDNEG, MIR_FABS,       MIR_DABS,
+  MIR_FFMA,  MIR_DFMA,  MIR_INSN_BOUND,
 };
 
 static MIR_insn_code_t get_ext_code (MIR_type_t type) {
@@ -579,6 +589,25 @@ static const char *UI2D_P = "mir.ui2d.p";
 static const char *UI2LD_P = "mir.ui2ld.p";
 static const char *LD2I_P = "mir.ld2i.p";
 
+static float mir_ffloor (float f) { return floorf (f); }
+static double mir_dfloor (double d) { return floor (d); }
+static float mir_fceil (float f) { return ceilf (f); }
+static double mir_dceil (double d) { return ceil (d); }
+static float mir_ftrunc (float f) { return truncf (f); }
+static double mir_dtrunc (double d) { return trunc (d); }
+static const char *FFLOOR = "mir.ffloor";
+static const char *FFLOOR_P = "mir.ffloor.p";
+static const char *DFLOOR = "mir.dfloor";
+static const char *DFLOOR_P = "mir.dfloor.p";
+static const char *FCEIL = "mir.fceil";
+static const char *FCEIL_P = "mir.fceil.p";
+static const char *DCEIL = "mir.dceil";
+static const char *DCEIL_P = "mir.dceil.p";
+static const char *FTRUNC = "mir.ftrunc";
+static const char *FTRUNC_P = "mir.ftrunc.p";
+static const char *DTRUNC = "mir.dtrunc";
+static const char *DTRUNC_P = "mir.dtrunc.p";
+
 static const char *VA_ARG_P = "mir.va_arg.p";
 static const char *VA_ARG = "mir.va_arg";
 static const char *VA_BLOCK_ARG_P = "mir.va_block_arg.p";
@@ -615,6 +644,42 @@ static void get_builtin (gen_ctx_t gen_ctx, MIR_insn_code_t code, MIR_item_t *pr
       = _MIR_builtin_proto (ctx, curr_func_item->module, LD2I_P, 1, &res_type, 1, MIR_T_LD, "v");
     *func_import_item = _MIR_builtin_func (ctx, curr_func_item->module, LD2I, mir_ld2i);
     break;
+  case MIR_FFLOOR:
+    res_type = MIR_T_F;
+    *proto_item
+      = _MIR_builtin_proto (ctx, curr_func_item->module, FFLOOR_P, 1, &res_type, 1, MIR_T_F, "f");
+    *func_import_item = _MIR_builtin_func (ctx, curr_func_item->module, FFLOOR, mir_ffloor);
+    break;
+  case MIR_DFLOOR:
+    res_type = MIR_T_D;
+    *proto_item
+      = _MIR_builtin_proto (ctx, curr_func_item->module, DFLOOR_P, 1, &res_type, 1, MIR_T_D, "d");
+    *func_import_item = _MIR_builtin_func (ctx, curr_func_item->module, DFLOOR, mir_dfloor);
+    break;
+  case MIR_FCEIL:
+    res_type = MIR_T_F;
+    *proto_item
+      = _MIR_builtin_proto (ctx, curr_func_item->module, FCEIL_P, 1, &res_type, 1, MIR_T_F, "f");
+    *func_import_item = _MIR_builtin_func (ctx, curr_func_item->module, FCEIL, mir_fceil);
+    break;
+  case MIR_DCEIL:
+    res_type = MIR_T_D;
+    *proto_item
+      = _MIR_builtin_proto (ctx, curr_func_item->module, DCEIL_P, 1, &res_type, 1, MIR_T_D, "d");
+    *func_import_item = _MIR_builtin_func (ctx, curr_func_item->module, DCEIL, mir_dceil);
+    break;
+  case MIR_FTRUNC:
+    res_type = MIR_T_F;
+    *proto_item
+      = _MIR_builtin_proto (ctx, curr_func_item->module, FTRUNC_P, 1, &res_type, 1, MIR_T_F, "f");
+    *func_import_item = _MIR_builtin_func (ctx, curr_func_item->module, FTRUNC, mir_ftrunc);
+    break;
+  case MIR_DTRUNC:
+    res_type = MIR_T_D;
+    *proto_item
+      = _MIR_builtin_proto (ctx, curr_func_item->module, DTRUNC_P, 1, &res_type, 1, MIR_T_D, "d");
+    *func_import_item = _MIR_builtin_func (ctx, curr_func_item->module, DTRUNC, mir_dtrunc);
+    break;
   case MIR_VA_ARG:
     res_type = MIR_T_I64;
     *proto_item = _MIR_builtin_proto (ctx, curr_func_item->module, VA_ARG_P, 1, &res_type, 2,
@@ -667,7 +732,7 @@ DEF_VARR (MIR_code_reloc_t);
 #define MOVDQA_CODE 0
 
 struct target_ctx {
-  unsigned char alloca_p, block_arg_func_p, leaf_p;
+  unsigned char alloca_p, block_arg_func_p, leaf_p, sse41_p, fma_p;
   int start_sp_from_bp_offset;
   VARR (int) * pattern_indexes;
   VARR (insn_pattern_info_t) * insn_pattern_info;
@@ -682,6 +747,8 @@ struct target_ctx {
 #define alloca_p gen_ctx->target_ctx->alloca_p
 #define block_arg_func_p gen_ctx->target_ctx->block_arg_func_p
 #define leaf_p gen_ctx->target_ctx->leaf_p
+#define sse41_p gen_ctx->target_ctx->sse41_p
+#define fma_p gen_ctx->target_ctx->fma_p
 #define start_sp_from_bp_offset gen_ctx->target_ctx->start_sp_from_bp_offset
 #define pattern_indexes gen_ctx->target_ctx->pattern_indexes
 #define insn_pattern_info gen_ctx->target_ctx->insn_pattern_info
@@ -838,6 +905,30 @@ static void target_machinize (gen_ctx_t gen_ctx) {
     next_insn = DLIST_NEXT (MIR_insn_t, insn);
     code = insn->code;
     switch (code) {
+    case MIR_FFMA:
+    case MIR_DFMA:
+      if (!fma_p) split_fma_insn (gen_ctx, insn);
+      break;
+    case MIR_SEL:
+    case MIR_FSEL:
+    case MIR_DSEL:
+      /* test and cmov have no immediate operands: */
+      for (i = 1; i < 4; i++)
+        if (insn->ops[i].mode == MIR_OP_INT || insn->ops[i].mode == MIR_OP_UINT) {
+          temp_op = MIR_new_reg_op (ctx, gen_new_temp_reg (gen_ctx, MIR_T_I64, func));
+          gen_add_insn_before (gen_ctx, insn, MIR_new_insn (ctx, MIR_MOV, temp_op, insn->ops[i]));
+          insn->ops[i] = temp_op;
+        }
+      break;
+    case MIR_FFLOOR:
+    case MIR_DFLOOR:
+    case MIR_FCEIL:
+    case MIR_DCEIL:
+    case MIR_FTRUNC:
+    case MIR_DTRUNC:
+      /* roundss/roundsd are SSE4.1, otherwise call the libm function */
+      if (sse41_p) break;
+      /* falls through */
     case MIR_UI2F:
     case MIR_UI2D:
     case MIR_UI2LD:
@@ -1561,6 +1652,58 @@ static const struct pattern patterns[] = {
   {MIR_DNEG, "r 0", "66 Y 0F 57 r0 c8000000000000000"}, /* xorpd r0,0x8000000000000000 */
   {MIR_LDNEG, "mld mld", "DB /5 m1; D9 E0; DB /7 m0"},  /* fld m1; fchs; fstp m0 */
 
+  {MIR_FSQRT, "r r", "F3 Y 0F 51 r0 R1"},  /* sqrtss r0,r1 */
+  {MIR_FSQRT, "r mf", "F3 Y 0F 51 r0 m1"}, /* sqrtss r0,m1 */
+  {MIR_DSQRT, "r r", "F2 Y 0F 51 r0 R1"},  /* sqrtsd r0,r1 */
+  {MIR_DSQRT, "r md", "F2 Y 0F 51 r0 m1"}, /* sqrtsd r0,m1 */
+
+  {MIR_FABS, "r 0", "Y 0F 54 r0 c000000007FFFFFFF"},    /* andps r0,7FFFFFFF */
+  {MIR_DABS, "r 0", "66 Y 0F 54 r0 c7FFFFFFFFFFFFFFF"}, /* andpd r0,0x7FFFFFFFFFFFFFFF */
+
+  /* SSE4.1, the immediate is the rounding mode with the precision exception suppressed: */
+  {MIR_FFLOOR, "r r", "66 Y 0F 3A 0A r0 R1 v9"},  /* roundss r0,r1,9 */
+  {MIR_FFLOOR, "r mf", "66 Y 0F 3A 0A r0 m1 v9"}, /* roundss r0,m1,9 */
+  {MIR_DFLOOR, "r r", "66 Y 0F 3A 0B r0 R1 v9"},  /* roundsd r0,r1,9 */
+  {MIR_DFLOOR, "r md", "66 Y 0F 3A 0B r0 m1 v9"}, /* roundsd r0,m1,9 */
+  {MIR_FCEIL, "r r", "66 Y 0F 3A 0A r0 R1 vA"},   /* roundss r0,r1,10 */
+  {MIR_FCEIL, "r mf", "66 Y 0F 3A 0A r0 m1 vA"},  /* roundss r0,m1,10 */
+  {MIR_DCEIL, "r r", "66 Y 0F 3A 0B r0 R1 vA"},   /* roundsd r0,r1,10 */
+  {MIR_DCEIL, "r md", "66 Y 0F 3A 0B r0 m1 vA"},  /* roundsd r0,m1,10 */
+  {MIR_FTRUNC, "r r", "66 Y 0F 3A 0A r0 R1 vB"},  /* roundss r0,r1,11 */
+  {MIR_FTRUNC, "r mf", "66 Y 0F 3A 0A r0 m1 vB"}, /* roundss r0,m1,11 */
+  {MIR_DTRUNC, "r r", "66 Y 0F 3A 0B r0 R1 vB"},  /* roundsd r0,r1,11 */
+  {MIR_DTRUNC, "r md", "66 Y 0F 3A 0B r0 m1 vB"}, /* roundsd r0,m1,11 */
+
+  /* FMA3, op0 is op1 after make_io_dup_op_insns: */
+  {MIR_FFMA, "r 0 r r", "66 w2 0F 38 A9 r0 R3"},  /* vfmadd213ss r0,r2,r3 */
+  {MIR_FFMA, "r 0 r mf", "66 w2 0F 38 A9 r0 m3"}, /* vfmadd213ss r0,r2,m3 */
+  {MIR_FFMA, "r 0 mf r", "66 w3 0F 38 99 r0 m2"}, /* vfmadd132ss r0,r3,m2 */
+  {MIR_DFMA, "r 0 r r", "66 W2 0F 38 A9 r0 R3"},  /* vfmadd213sd r0,r2,r3 */
+  {MIR_DFMA, "r 0 r md", "66 W2 0F 38 A9 r0 m3"}, /* vfmadd213sd r0,r2,m3 */
+  {MIR_DFMA, "r 0 md r", "66 W3 0F 38 99 r0 m2"}, /* vfmadd132sd r0,r3,m2 */
+
+  /* mov %rdx,r3;test r1,r1;cmovne %rdx,r2;mov r0,%rdx, op3 stays in memory when spilled: */
+  {MIR_SEL, "r r r r", "X 8B h2 R3; X 85 r1 R1; X 0F 45 h2 R2; X 8B r0 H2"},
+  {MIR_SEL, "r r r m3", "X 8B h2 m3; X 85 r1 R1; X 0F 45 h2 R2; X 8B r0 H2"},
+  {MIR_SEL, "r r m3 r", "X 8B h2 R3; X 85 r1 R1; X 0F 45 h2 m2; X 8B r0 H2"},
+  {MIR_SEL, "r r m3 m3", "X 8B h2 m3; X 85 r1 R1; X 0F 45 h2 m2; X 8B r0 H2"},
+  /* movd %eax,r2;movd %edx,r3;test r1,r1;cmovne %eax,%edx;movd r0,%edx: */
+  {MIR_FSEL, "r r r r",
+   "66 Y 0F 7E r2 H0; 66 Y 0F 7E r3 H2; X 85 r1 R1; Y 0F 45 h2 H0; 66 Y 0F 6E r0 H2"},
+  {MIR_FSEL, "r r r mf",
+   "66 Y 0F 7E r2 H0; Y 8B h2 m3; X 85 r1 R1; Y 0F 45 h2 H0; 66 Y 0F 6E r0 H2"},
+  {MIR_FSEL, "r r mf r",
+   "Y 8B h0 m2; 66 Y 0F 7E r3 H2; X 85 r1 R1; Y 0F 45 h2 H0; 66 Y 0F 6E r0 H2"},
+  {MIR_FSEL, "r r mf mf", "Y 8B h0 m2; Y 8B h2 m3; X 85 r1 R1; Y 0F 45 h2 H0; 66 Y 0F 6E r0 H2"},
+  /* movq %rax,r2;movq %rdx,r3;test r1,r1;cmovne %rax,%rdx;movq r0,%rdx: */
+  {MIR_DSEL, "r r r r",
+   "66 X 0F 7E r2 H0; 66 X 0F 7E r3 H2; X 85 r1 R1; X 0F 45 h2 H0; 66 X 0F 6E r0 H2"},
+  {MIR_DSEL, "r r r md",
+   "66 X 0F 7E r2 H0; X 8B h2 m3; X 85 r1 R1; X 0F 45 h2 H0; 66 X 0F 6E r0 H2"},
+  {MIR_DSEL, "r r md r",
+   "X 8B h0 m2; 66 X 0F 7E r3 H2; X 85 r1 R1; X 0F 45 h2 H0; 66 X 0F 6E r0 H2"},
+  {MIR_DSEL, "r r md md", "X 8B h0 m2; X 8B h2 m3; X 85 r1 R1; X 0F 45 h2 H0; 66 X 0F 6E r0 H2"},
+
   IOP (MIR_ADD, "03", "01", "83 /0", "81 /0") /* x86_64 int additions */
 
   {MIR_ADD, "r r r", "X 8D r0 ap"},   /* lea r0,(r1,r2)*/
@@ -1671,8 +1814,12 @@ static void target_get_early_clobbered_hard_regs (MIR_insn_t insn, MIR_reg_t *hr
 
   *hr1 = *hr2 = MIR_NON_HARD_REG;
   if (code == MIR_DIV || code == MIR_UDIV || code == MIR_DIVS || code == MIR_UDIVS
-      || code == MIR_MOD || code == MIR_UMOD || code == MIR_MODS || code == MIR_UMODS) {
+      || code == MIR_MOD || code == MIR_UMOD || code == MIR_MODS || code == MIR_UMODS
+      || code == MIR_SEL) {
     *hr1 = DX_HARD_REG;
+  } else if (code == MIR_FSEL || code == MIR_DSEL) {
+    *hr1 = AX_HARD_REG;
+    *hr2 = DX_HARD_REG;
   } else if (code == MIR_FEQ || code == MIR_FNE || code == MIR_DEQ || code == MIR_DNE
              || code == MIR_LDEQ || code == MIR_LDNE) {
     *hr1 = AX_HARD_REG;
@@ -2104,6 +2251,7 @@ static void out_insn (gen_ctx_t gen_ctx, MIR_insn_t insn, const char *replacemen
     int d1, d2;
     int opcode0 = -1, opcode1 = -1, opcode2 = -1;
     int rex_w = -1, rex_r = -1, rex_x = -1, rex_b = -1, rex_0 = -1;
+    int vex_w = -1, vex_v = -1;
     int mod = -1, reg = -1, rm = -1;
     int scale = -1, index = -1, base = -1;
     int prefix = -1, disp8 = -1, imm8 = -1, lb = -1;
@@ -2156,10 +2304,24 @@ static void out_insn (gen_ctx_t gen_ctx, MIR_insn_t insn, const char *replacemen
         rex_w = 0;
         rex_0 = 0;
         break;
+      case 'w':
+      case 'W':
+        if (opcode0 >= 0) {
+          gen_assert (opcode1 < 0);
+          prefix = opcode0;
+          opcode0 = -1;
+        }
+        vex_w = start_ch == 'W';
+        ch = *++p;
+        gen_assert ('0' <= ch && ch <= '3');
+        op = insn->ops[ch - '0'];
+        gen_assert (op.mode == MIR_OP_HARD_REG && op.u.hard_reg >= XMM0_HARD_REG);
+        vex_v = op.u.hard_reg - XMM0_HARD_REG;
+        break;
       case 'r':
       case 'R':
         ch = *++p;
-        gen_assert ('0' <= ch && ch <= '2');
+        gen_assert ('0' <= ch && ch <= '3');
         op = insn->ops[ch - '0'];
         gen_assert (op.mode == MIR_OP_HARD_REG);
         if (start_ch == 'r')
@@ -2186,7 +2348,7 @@ static void out_insn (gen_ctx_t gen_ctx, MIR_insn_t insn, const char *replacemen
           setup_mem (mem.u.hard_reg_mem, &mod, &rm, &scale, &base, &rex_b, &index, &rex_x, &disp8,
                      &disp32);
         } else {
-          gen_assert ('0' <= ch && ch <= '2');
+          gen_assert ('0' <= ch && ch <= '3');
           op = insn->ops[ch - '0'];
           gen_assert (op.mode == MIR_OP_HARD_REG_MEM);
           setup_mem (op.u.hard_reg_mem, &mod, &rm, &scale, &base, &rex_b, &index, &rex_x, &disp8,
@@ -2327,6 +2489,20 @@ static void out_insn (gen_ctx_t gen_ctx, MIR_insn_t insn, const char *replacemen
       default: gen_assert (FALSE);
       }
     }
+    if (vex_w >= 0) { /* 3-byte VEX: the prefix and the 0F/0F38/0F3A escape are folded into it */
+      gen_assert (opcode0 == 0x0f && (opcode1 == 0x38 || opcode1 == 0x3a) && opcode2 >= 0 && rex_0 < 0);
+      put_byte (gen_ctx, 0xc4);
+      put_byte (gen_ctx, ((rex_r > 0 ? 0 : 1) << 7) | ((rex_x > 0 ? 0 : 1) << 6)
+                           | ((rex_b > 0 ? 0 : 1) << 5) | (opcode1 == 0x38 ? 2 : 3));
+      put_byte (gen_ctx, (vex_w << 7) | ((~vex_v & 0xf) << 3)
+                           | (prefix == 0x66   ? 1
+                              : prefix == 0xf3 ? 2
+                              : prefix == 0xf2 ? 3
+                                               : 0));
+      opcode0 = opcode2;
+      opcode1 = opcode2 = prefix = -1;
+      rex_w = rex_r = rex_x = rex_b = -1;
+    }
     if (prefix >= 0) put_byte (gen_ctx, prefix);
 
     if (rex_w > 0 || rex_r >= 0 || rex_x >= 0 || rex_b >= 0 || rex_0 >= 0) {
@@ -2479,8 +2655,47 @@ static void target_rebase (gen_ctx_t gen_ctx, uint8_t *base) {
                         VARR_ADDR (MIR_code_reloc_t, relocs));
 }
 
+/* CPUID.1:ECX bit 19 */
+static int cpu_sse41_p (void) {
+#if defined(_MSC_VER)
+  int info[4];
+
+  __cpuid (info, 1);
+  return (info[2] >> 19) & 1;
+#else
+  unsigned int eax, ebx, ecx, edx;
+
+  if (!__get_cpuid (1, &eax, &ebx, &ecx, &edx)) return FALSE;
+  return (ecx >> 19) & 1;
+#endif
+}
+
+/* CPUID.1:ECX bit 12, VEX also needs AVX enabled by the OS: OSXSAVE and the XMM/YMM state in
+   XCR0 */
+static int cpu_fma_p (void) {
+  unsigned long long xcr0;
+#if defined(_MSC_VER)
+  int info[4];
+
+  __cpuid (info, 1);
+  if (((info[2] >> 12) & 1) == 0 || ((info[2] >> 27) & 1) == 0 || ((info[2] >> 28) & 1) == 0)
+    return FALSE;
+  xcr0 = _xgetbv (0);
+#else
+  unsigned int eax, ebx, ecx, edx;
+
+  if (!__get_cpuid (1, &eax, &ebx, &ecx, &edx)) return FALSE;
+  if (((ecx >> 12) & 1) == 0 || ((ecx >> 27) & 1) == 0 || ((ecx >> 28) & 1) == 0) return FALSE;
+  __asm__ __volatile__ ("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+  xcr0 = ((unsigned long long) edx << 32) | eax;
+#endif
+  return (xcr0 & 6) == 6;
+}
+
 static void target_init (gen_ctx_t gen_ctx) {
   gen_ctx->target_ctx = gen_malloc (gen_ctx, sizeof (struct target_ctx));
+  sse41_p = cpu_sse41_p ();
+  fma_p = cpu_fma_p ();
   VARR_CREATE (uint8_t, result_code, 0);
   VARR_CREATE (uint64_t, const_pool, 0);
   VARR_CREATE (const_ref_t, const_refs, 0);
@@ -92,6 +92,7 @@ static void gen_delete_insn (gen_ctx_t gen_ctx, MIR_insn_t insn);
 static void gen_add_insn_before (gen_ctx_t gen_ctx, MIR_insn_t before, MIR_insn_t insn);
 static void gen_add_insn_after (gen_ctx_t gen_ctx, MIR_insn_t after, MIR_insn_t insn);
 static void setup_call_hard_reg_args (gen_ctx_t gen_ctx, MIR_insn_t call_insn, MIR_reg_t hard_reg);
+static void split_fma_insn (gen_ctx_t gen_ctx, MIR_insn_t insn);
 
 #ifndef MIR_GEN_CALL_TRACE
 #define MIR_GEN_CALL_TRACE 0
@@ -648,6 +649,58 @@ static void gen_add_insn_after (gen_ctx_t gen_ctx, MIR_insn_t after, MIR_insn_t
   create_new_bb_insns (gen_ctx, after, DLIST_NEXT (MIR_insn_t, insn), after);
 }
 
+/* Replace fma for a target without fused multiply-add.  The moves through a new temp keep the
+   insns in the form required by the targets with two operand arithmetic: */
+static void split_fma_insn (gen_ctx_t gen_ctx, MIR_insn_t insn) {
+  MIR_context_t ctx = gen_ctx->ctx;
+  MIR_type_t type = insn->code == MIR_FFMA ? MIR_T_F : MIR_T_D;
+  MIR_insn_code_t mov_code = type == MIR_T_F ? MIR_FMOV : MIR_DMOV;
+  MIR_op_t temp_op = MIR_new_reg_op (ctx, gen_new_temp_reg (gen_ctx, type, curr_func_item->u.func));
+
+  gen_assert (insn->code == MIR_FFMA || insn->code == MIR_DFMA);
+  gen_add_insn_before (gen_ctx, insn, MIR_new_insn (ctx, mov_code, temp_op, insn->ops[1]));
+  gen_add_insn_before (gen_ctx, insn,
+                       MIR_new_insn (ctx, type == MIR_T_F ? MIR_FMUL : MIR_DMUL, temp_op, temp_op,
+                                     insn->ops[2]));
+  gen_add_insn_before (gen_ctx, insn,
+                       MIR_new_insn (ctx, type == MIR_T_F ? MIR_FADD : MIR_DADD, temp_op, temp_op,
+                                     insn->ops[3]));
+  gen_add_insn_before (gen_ctx, insn, MIR_new_insn (ctx, mov_code, insn->ops[0], temp_op));
+  gen_delete_insn (gen_ctx, insn);
+}
+
+/* Replace the select insns with a branch for a target without conditional moves.  It is done
+   before building the CFG as the branch starts a new basic block: */
+static void split_sel_insns (gen_ctx_t gen_ctx) {
+  MIR_context_t ctx = gen_ctx->ctx;
+  MIR_func_t func = curr_func_item->u.func;
+  MIR_insn_t insn, next_insn, label;
+  MIR_insn_code_t mov_code;
+  MIR_type_t type;
+  MIR_op_t temp_op;
+
+  for (insn = DLIST_HEAD (MIR_insn_t, func->insns); insn != NULL; insn = next_insn) {
+    next_insn = DLIST_NEXT (MIR_insn_t, insn);
+    if (insn->code != MIR_SEL && insn->code != MIR_FSEL && insn->code != MIR_DSEL) continue;
+    type = insn->code == MIR_SEL ? MIR_T_I64 : insn->code == MIR_FSEL ? MIR_T_F : MIR_T_D;
+    mov_code = type == MIR_T_I64 ? MIR_MOV : type == MIR_T_F ? MIR_FMOV : MIR_DMOV;
+    /* temp = op2; bt L, op1; temp = op3; L: op0 = temp */
+    temp_op = MIR_new_reg_op (ctx, _MIR_new_temp_reg (ctx, type, func));
+    label = MIR_new_label (ctx);
+    MIR_insert_insn_before (ctx, curr_func_item, insn,
+                            MIR_new_insn (ctx, mov_code, temp_op, insn->ops[2]));
+    MIR_insert_insn_before (ctx, curr_func_item, insn,
+                            MIR_new_insn (ctx, MIR_BT, MIR_new_label_op (ctx, label),
+                                          insn->ops[1]));
+    MIR_insert_insn_before (ctx, curr_func_item, insn,
+                            MIR_new_insn (ctx, mov_code, temp_op, insn->ops[3]));
+    MIR_insert_insn_before (ctx, curr_func_item, insn, label);
+    MIR_insert_insn_before (ctx, curr_func_item, insn,
+                            MIR_new_insn (ctx, mov_code, insn->ops[0], temp_op));
+    MIR_remove_insn (ctx, curr_func_item, insn);
+  }
+}
+
 static void gen_move_insn_before (gen_ctx_t gen_ctx, MIR_insn_t before, MIR_insn_t insn) {
   DLIST_REMOVE (MIR_insn_t, curr_func_item->u.func->insns, insn);
   MIR_insert_insn_before (gen_ctx->ctx, curr_func_item, before, insn);
@@ -4147,8 +4200,11 @@ static void assign (gen_ctx_t gen_ctx) {
   });
 }
 
+/* Return the hard reg loaded from or stored to the stack slot of REG, or MIR_NON_HARD_REG when
+   the insn should use MEM_OP directly.  MEM_P requests that for an input. */
 static MIR_reg_t change_reg (gen_ctx_t gen_ctx, MIR_op_t *mem_op, MIR_reg_t reg,
-                             MIR_op_mode_t data_mode, int first_p, MIR_insn_t insn, int out_p) {
+                             MIR_op_mode_t data_mode, int first_p, MIR_insn_t insn, int out_p,
+                             int mem_p) {
   MIR_context_t ctx = gen_ctx->ctx;
   MIR_reg_t loc = VARR_GET (MIR_reg_t, breg_renumber, reg2breg (gen_ctx, reg));
   MIR_reg_t hard_reg;
@@ -4195,6 +4251,10 @@ static MIR_reg_t change_reg (gen_ctx_t gen_ctx, MIR_op_t *mem_op, MIR_reg_t reg,
     *mem_op = _MIR_new_hard_reg_mem_op (ctx, type, 0, temp_hard_reg, MIR_NON_HARD_REG, 0);
   }
   if (hard_reg == MIR_NON_HARD_REG) return hard_reg;
+  if (mem_p) {
+    gen_assert (!out_p && n == 0);
+    return MIR_NON_HARD_REG;
+  }
   hard_reg_op = _MIR_new_hard_reg_op (ctx, hard_reg);
   if (!out_p) {
     new_insns[n++] = MIR_new_insn (ctx, code, hard_reg_op, *mem_op);
@@ -4264,8 +4324,14 @@ static void rewrite (gen_ctx_t gen_ctx) {
           bitmap_set_bit_p (func_used_hard_regs, op->u.hard_reg_mem.index);
         break;
       case MIR_OP_REG:
-        hard_reg
-          = change_reg (gen_ctx, &mem_op, op->u.reg, data_mode, out_p || first_in_p, insn, out_p);
+        /* There are only two temp hard regs, the addend of a spilled multiply-add and the last
+           operand of a spilled select stay in memory */
+        hard_reg = change_reg (gen_ctx, &mem_op, op->u.reg, data_mode, out_p || first_in_p, insn,
+                               out_p,
+                               i == 3
+                                 && (insn->code == MIR_FFMA || insn->code == MIR_DFMA
+                                     || insn->code == MIR_SEL || insn->code == MIR_FSEL
+                                     || insn->code == MIR_DSEL));
         if (!out_p) first_in_p = FALSE;
         if (hard_reg == MIR_NON_HARD_REG) {
           *op = mem_op;
@@ -4280,7 +4346,8 @@ static void rewrite (gen_ctx_t gen_ctx) {
         if (op->u.mem.base == 0) {
           mem.base = MIR_NON_HARD_REG;
         } else {
-          mem.base = change_reg (gen_ctx, &mem_op, op->u.mem.base, MIR_OP_INT, FALSE, insn, FALSE);
+          mem.base
+            = change_reg (gen_ctx, &mem_op, op->u.mem.base, MIR_OP_INT, FALSE, insn, FALSE, FALSE);
           gen_assert (mem.base != MIR_NON_HARD_REG); /* we can always use GP regs */
         }
         gen_assert (op->u.mem.index == 0);
@@ -5313,6 +5380,7 @@ void *MIR_gen (MIR_context_t ctx, int gen_num, MIR_item_t func_item) {
   curr_func_item = func_item;
   _MIR_duplicate_func_insns (ctx, func_item);
   curr_cfg = func_item->data = gen_malloc (gen_ctx, sizeof (struct func_cfg));
+  if (!target_sel_p) split_sel_insns (gen_ctx);
   build_func_cfg (gen_ctx);
   DEBUG ({
     fprintf (debug_file, "+++++++++++++MIR after building CFG:\n");
@@ -16,6 +16,8 @@ void MIR_interp_arr (MIR_context_t ctx, MIR_item_t func_item, MIR_val_t *results
 void MIR_set_interp_interface (MIR_context_t ctx, MIR_item_t func_item) {}
 #else
 
+#include <math.h>
+
 #ifndef MIR_INTERP_TRACE
 #define MIR_INTERP_TRACE 0
 #endif
@@ -679,12 +681,24 @@ static ALWAYS_INLINE int64_t get_mem_addr (MIR_val_t *bp, code_t c) { return bp[
     r = get_2fops (bp, ops, &p); \
     *r = op p;                   \
   } while (0)
+#define FFN2(fn)                 \
+  do {                           \
+    float *r, p;                 \
+    r = get_2fops (bp, ops, &p); \
+    *r = fn (p);                 \
+  } while (0)
 #define FOP3(op)                       \
   do {                                 \
     float *r, p1, p2;                  \
     r = get_3fops (bp, ops, &p1, &p2); \
     *r = p1 op p2;                     \
   } while (0)
+#define FFMA4()                                                     \
+  do {                                                              \
+    float p1 = *get_fop (bp, ops + 1), p2 = *get_fop (bp, ops + 2); \
+    float p3 = *get_fop (bp, ops + 3);                              \
+    *get_fop (bp, ops) = fmaf (p1, p2, p3);                         \
+  } while (0)
 #define FCMP(op)                          \
   do {                                    \
     int64_t *r;                           \
@@ -704,12 +718,28 @@ static ALWAYS_INLINE int64_t get_mem_addr (MIR_val_t *bp, code_t c) { return bp[
     r = get_2dops (bp, ops, &p); \
     *r = op p;                   \
   } while (0)
+#define DFN2(fn)                 \
+  do {                           \
+    double *r, p;                \
+    r = get_2dops (bp, ops, &p); \
+    *r = fn (p);                 \
+  } while (0)
 #define DOP3(op)                       \
   do {                                 \
     double *r, p1, p2;                 \
     r = get_3dops (bp, ops, &p1, &p2); \
     *r = p1 op p2;                     \
   } while (0)
+#define DFMA4()                                                      \
+  do {                                                               \
+    double p1 = *get_dop (bp, ops + 1), p2 = *get_dop (bp, ops + 2); \
+    double p3 = *get_dop (bp, ops + 3);                              \
+    *get_dop (bp, ops) = fma (p1, p2, p3);                           \
+  } while (0)
+#define SEL4(get)                                                                      \
+  do {                                                                                 \
+    *get (bp, ops) = *get_iop (bp, ops + 1) ? *get (bp, ops + 2) : *get (bp, ops + 3); \
+  } while (0)
 #define DCMP(op)                          \
   do {                                    \
     int64_t *r;                           \
@@ -902,7 +932,10 @@ static void OPTIMIZE eval (MIR_context_t ctx, func_desc_t func_desc, MIR_val_t *
     REP6 (LAB_EL, MIR_EXT8, MIR_EXT16, MIR_EXT32, MIR_UEXT8, MIR_UEXT16, MIR_UEXT32);
     REP6 (LAB_EL, MIR_I2F, MIR_I2D, MIR_I2LD, MIR_UI2F, MIR_UI2D, MIR_UI2LD);
     REP8 (LAB_EL, MIR_F2I, MIR_D2I, MIR_LD2I, MIR_F2D, MIR_F2LD, MIR_D2F, MIR_D2LD, MIR_LD2F);
-    REP8 (LAB_EL, MIR_LD2D, MIR_NEG, MIR_NEGS, MIR_FNEG, MIR_DNEG, MIR_LDNEG, MIR_ADD, MIR_ADDS);
+    REP6 (LAB_EL, MIR_LD2D, MIR_NEG, MIR_NEGS, MIR_FNEG, MIR_DNEG, MIR_LDNEG);
+    REP4 (LAB_EL, MIR_FSQRT, MIR_DSQRT, MIR_FABS, MIR_DABS);
+    REP6 (LAB_EL, MIR_FFLOOR, MIR_DFLOOR, MIR_FCEIL, MIR_DCEIL, MIR_FTRUNC, MIR_DTRUNC);
+    REP2 (LAB_EL, MIR_ADD, MIR_ADDS);
     REP8 (LAB_EL, MIR_FADD, MIR_DADD, MIR_LDADD, MIR_SUB, MIR_SUBS, MIR_FSUB, MIR_DSUB, MIR_LDSUB);
     REP8 (LAB_EL, MIR_MUL, MIR_MULS, MIR_FMUL, MIR_DMUL, MIR_LDMUL, MIR_DIV, MIR_DIVS, MIR_UDIV);
     REP8 (LAB_EL, MIR_UDIVS, MIR_FDIV, MIR_DDIV, MIR_LDDIV, MIR_MOD, MIR_MODS, MIR_UMOD, MIR_UMODS);
@@ -912,7 +945,10 @@ static void OPTIMIZE eval (MIR_context_t ctx, func_desc_t func_desc, MIR_val_t *
     REP8 (LAB_EL, MIR_ULT, MIR_ULTS, MIR_FLT, MIR_DLT, MIR_LDLT, MIR_LE, MIR_LES, MIR_ULE);
     REP8 (LAB_EL, MIR_ULES, MIR_FLE, MIR_DLE, MIR_LDLE, MIR_GT, MIR_GTS, MIR_UGT, MIR_UGTS);
     REP8 (LAB_EL, MIR_FGT, MIR_DGT, MIR_LDGT, MIR_GE, MIR_GES, MIR_UGE, MIR_UGES, MIR_FGE);
-    REP8 (LAB_EL, MIR_DGE, MIR_LDGE, MIR_JMP, MIR_BT, MIR_BTS, MIR_BF, MIR_BFS, MIR_BEQ);
+    REP2 (LAB_EL, MIR_DGE, MIR_LDGE);
+    REP2 (LAB_EL, MIR_FFMA, MIR_DFMA);
+    REP3 (LAB_EL, MIR_SEL, MIR_FSEL, MIR_DSEL);
+    REP6 (LAB_EL, MIR_JMP, MIR_BT, MIR_BTS, MIR_BF, MIR_BFS, MIR_BEQ);
     REP8 (LAB_EL, MIR_BEQS, MIR_FBEQ, MIR_DBEQ, MIR_LDBEQ, MIR_BNE, MIR_BNES, MIR_FBNE, MIR_DBNE);
     REP8 (LAB_EL, MIR_LDBNE, MIR_BLT, MIR_BLTS, MIR_UBLT, MIR_UBLTS, MIR_FBLT, MIR_DBLT, MIR_LDBLT);
     REP8 (LAB_EL, MIR_BLE, MIR_BLES, MIR_UBLE, MIR_UBLES, MIR_FBLE, MIR_DBLE, MIR_LDBLE, MIR_BGT);
@@ -1112,6 +1148,17 @@ static void OPTIMIZE eval (MIR_context_t ctx, func_desc_t func_desc, MIR_val_t *
   SCASE (MIR_DNEG, 2, DOP2 (-));
   SCASE (MIR_LDNEG, 2, LDOP2 (-));
 
+  SCASE (MIR_FSQRT, 2, FFN2 (sqrtf));
+  SCASE (MIR_DSQRT, 2, DFN2 (sqrt));
+  SCASE (MIR_FABS, 2, FFN2 (fabsf));
+  SCASE (MIR_DABS, 2, DFN2 (fabs));
+  SCASE (MIR_FFLOOR, 2, FFN2 (floorf));
+  SCASE (MIR_DFLOOR, 2, DFN2 (floor));
+  SCASE (MIR_FCEIL, 2, FFN2 (ceilf));
+  SCASE (MIR_DCEIL, 2, DFN2 (ceil));
+  SCASE (MIR_FTRUNC, 2, FFN2 (truncf));
+  SCASE (MIR_DTRUNC, 2, DFN2 (trunc));
+
   SCASE (MIR_ADD, 3, IOP3 (+));
   SCASE (MIR_ADDS, 3, IOP3S (+));
   SCASE (MIR_FADD, 3, FOP3 (+));
@@ -1201,6 +1248,13 @@ static void OPTIMIZE eval (MIR_context_t ctx, func_desc_t func_desc, MIR_val_t *
   SCASE (MIR_DGE, 3, DCMP (>=));
   SCASE (MIR_LDGE, 3, LDCMP (>=));
 
+  SCASE (MIR_FFMA, 4, FFMA4 ());
+  SCASE (MIR_DFMA, 4, DFMA4 ());
+
+  SCASE (MIR_SEL, 4, SEL4 (get_iop));
+  SCASE (MIR_FSEL, 4, SEL4 (get_fop));
+  SCASE (MIR_DSEL, 4, SEL4 (get_dop));
+
   SCASE (MIR_JMP, 1, pc = code + get_i (ops));
   CASE (MIR_BT, 2) {
     int64_t cond = *get_iop (bp, ops + 1);
@@ -131,6 +131,8 @@ typedef enum {
   REP3 (INSN_EL, F2I, D2I, LD2I),    /* Float or (long) double to integer conversion */
   REP6 (INSN_EL, F2D, F2LD, D2F, D2LD, LD2F, LD2D), /* Float, (long) double conversions */
   REP5 (INSN_EL, NEG, NEGS, FNEG, DNEG, LDNEG),     /* Changing sign */
+  REP4 (INSN_EL, FSQRT, DSQRT, FABS, DABS),         /* Square root and absolute value */
+  REP6 (INSN_EL, FFLOOR, DFLOOR, FCEIL, DCEIL, FTRUNC, DTRUNC), /* Rounding to an integral value */
   /* 3 operand insn: */
   REP5 (INSN_EL, ADD, ADDS, FADD, DADD, LDADD),              /* Addition */
   REP5 (INSN_EL, SUB, SUBS, FSUB, DSUB, LDSUB),              /* Subtraction */
@@ -145,6 +147,9 @@ typedef enum {
   REP7 (INSN_EL, LE, LES, ULE, ULES, FLE, DLE, LDLE),        /* Less or equal */
   REP7 (INSN_EL, GT, GTS, UGT, UGTS, FGT, DGT, LDGT),        /* Greater then */
   REP7 (INSN_EL, GE, GES, UGE, UGES, FGE, DGE, LDGE),        /* Greater or equal */
+  /* 4 operand insns: */
+  REP2 (INSN_EL, FFMA, DFMA), /* op1 * op2 + op3, fused when the target can do it */
+  REP3 (INSN_EL, SEL, FSEL, DSEL), /* op1 != 0 ? op2 : op3 without a branch when possible */
   /* Unconditional (1 operand) and conditional (2 operands) branch
      insns.  The first operand is a label.  */
   REP5 (INSN_EL, JMP, BT, BTS, BF, BFS),
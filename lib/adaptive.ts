@@ -0,0 +1,118 @@
+import { JeetahFn, VarType, compileBody } from './compiler';
+
+// Only Float64 computes in the same type in V8 and in MIR: V8 would compute
+// a Float32 expression in double and round only the result, the integer
+// types would need |0 after every operation
+
+interface NativeExpression {
+    readonly fn: JeetahFn;
+    map(array: Float64Array, iter: string, result?: Float64Array): Float64Array;
+}
+
+type Fallback = (array: Float64Array, result: Float64Array) => void;
+
+interface Dispatch {
+    iter: string;
+    threshold: number;
+    fallback: Fallback;
+}
+
+// Calibration runs the two implementations on these sizes
+// and extrapolates linearly to find the break-even point
+const calibrationSmall = 16;
+const calibrationLarge = 4096;
+const calibrationBudget = 1e6; // ns per measurement
+
+const dispatch = new WeakMap<NativeExpression, Dispatch>();
+
+// Every expression gets its own loop so that V8 sees
+// a monomorphic call site it can inline
+export function buildFallback(fn: JeetahFn, type: VarType, iter: string): Fallback {
+    const params = Object.keys(compileBody(fn, type).params);
+    if (!params.includes(iter))
+        throw new ReferenceError(`Unknown argument ${iter}`);
+    const args = params.map((p) => p === iter ? 'array[i]' : '0').join(', ');
+
+    return new Function('fn', `return function (array, result) {
+            const len = array.length;
+            for (let i = 0; i < len; i++)
+                result[i] = fn(${args});
+        };`)(fn) as Fallback;
+}
+
+function measure(run: () => void): number {
+    run();
+    const start = process.hrtime.bigint();
+    let reps = 0;
+    let elapsed = 0;
+    do {
+        run();
+        reps++;
+        elapsed = Number(process.hrtime.bigint() - start);
+    } while (elapsed < calibrationBudget);
+    return elapsed / reps;
+}
+
+export function calibrate(expr: NativeExpression, d: Dispatch, sample: Float64Array): number {
+    const fill = (len: number) => {
+        const a = new Float64Array(len);
+        for (let i = 0; i < len; i++)
+            a[i] = sample.length ? sample[i % sample.length] : 0;
+        return a;
+    };
+    const small = fill(calibrationSmall);
+    const large = fill(calibrationLarge);
+    const result = new Float64Array(calibrationLarge);
+
+    // warm-up V8 before measuring anything
+    for (let i = 0; i < 100; i++)
+        d.fallback(small, result);
+
+    const nativeSmall = measure(() => expr.map(small, d.iter, result));
+    const nativeLarge = measure(() => expr.map(large, d.iter, result));
+    const jsSmall = measure(() => d.fallback(small, result));
+    const jsLarge = measure(() => d.fallback(large, result));
+
+    const nativeElement = (nativeLarge - nativeSmall) / (calibrationLarge - calibrationSmall);
+    const jsElement = (jsLarge - jsSmall) / (calibrationLarge - calibrationSmall);
+    if (jsElement <= nativeElement)
+        return Infinity;
+    const nativeCall = nativeSmall - nativeElement * calibrationSmall;
+    const jsCall = jsSmall - jsElement * calibrationSmall;
+
+    return Math.max(0, Math.ceil((nativeCall - jsCall) / (jsElement - nativeElement)));
+}
+
+function adaptiveMap(this: NativeExpression, array: Float64Array, iter: string, result?: Float64Array): Float64Array {
+    if (!(array instanceof Float64Array))
+        throw new TypeError('Missing mandatory TypedArray argument');
+    if (result !== undefined && !(result instanceof Float64Array))
+        throw new TypeError('Target array does not expression type');
+
+    let d = dispatch.get(this);
+    if (!d || d.iter !== iter) {
+        if (this.fn === undefined)
+            throw new Error('Expression has been disposed');
+        d = { iter, threshold: 0, fallback: buildFallback(this.fn, 'Float64', iter) };
+        d.threshold = calibrate(this, d, array);
+        dispatch.set(this, d);
+    }
+
+    if (array.length >= d.threshold)
+        return result === undefined ? this.map(array, iter) : this.map(array, iter, result);
+
+    if (result === undefined)
+        result = new Float64Array(array.length);
+    d.fallback(array, result);
+    return result;
+}
+
+// eslint-disable-next-line @typescript-eslint/no-explicit-any
+export function installAdaptive(cls: { prototype: any }): void {
+    const dispose = cls.prototype.dispose;
+    cls.prototype.adaptiveMap = adaptiveMap;
+    cls.prototype.dispose = function (this: NativeExpression) {
+        dispatch.delete(this);
+        return dispose.call(this);
+    };
+}
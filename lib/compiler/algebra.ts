@@ -0,0 +1,165 @@
+import * as estree from 'estree';
+import { Rewrites } from '.';
+import { literal, binary, isMathCall, globalConstant } from './ast';
+
+// { fastMath: true } algebraic simplifications, all of them can change the result:
+//   x / k              becomes x * (1 / k)                  'reciprocal'
+//   x + 1 + y + 2      becomes x + y + 3 and 2 * x * 3 becomes x * 6,
+//   the constants of a chain of + or * are folded       'reassociation'
+//   Math.exp(Math.log(x)) becomes x                         'exp-log'
+//   x * 1, x / 1, x + 0 and x - 0 become x                  'identity'
+// The operands are still evaluated in the same order
+
+export function countRewrite(rewrites: Rewrites | undefined, name: string): void {
+    if (rewrites)
+        rewrites[name] = (rewrites[name] || 0) + 1;
+}
+
+function constant(node: estree.Node): number | undefined {
+    switch (node.type) {
+        case 'Literal':
+            return typeof node.value === 'number' ? node.value : undefined;
+        case 'MemberExpression':
+            return globalConstant(node);
+        case 'UnaryExpression': {
+            const a = node.operator === '-' ? constant(node.argument) : undefined;
+            return a === undefined ? undefined : -a;
+        }
+    }
+    return undefined;
+}
+
+interface Term {
+    node: estree.Expression;
+    // subtracted from a sum
+    negative: boolean;
+}
+
+// The operands of a chain of additions and subtractions
+function sumTerms(node: estree.Expression, negative: boolean, terms: Term[]): void {
+    if (node.type === 'BinaryExpression' && (node.operator === '+' || node.operator === '-')) {
+        sumTerms(node.left as estree.Expression, negative, terms);
+        sumTerms(node.right, node.operator === '-' ? !negative : negative, terms);
+    } else {
+        terms.push({ node, negative });
+    }
+}
+
+// The factors of a chain of multiplications, / stops the chain
+function productTerms(node: estree.Expression, terms: estree.Expression[]): void {
+    if (node.type === 'BinaryExpression' && node.operator === '*') {
+        productTerms(node.left as estree.Expression, terms);
+        productTerms(node.right, terms);
+    } else {
+        terms.push(node);
+    }
+}
+
+function reassociateSum(node: estree.BinaryExpression, rewrites?: Rewrites): estree.Expression {
+    const terms: Term[] = [];
+    sumTerms(node, false, terms);
+    let k = 0;
+    let constants = 0;
+    const rest: Term[] = [];
+    for (const t of terms) {
+        const v = constant(t.node);
+        if (v !== undefined) {
+            k += t.negative ? -v : v;
+            constants++;
+        } else {
+            rest.push(t);
+        }
+    }
+    if (constants === 0 || (constants === 1 && k !== 0))
+        return node;
+    countRewrite(rewrites, constants > 1 ? 'reassociation' : 'identity');
+    if (rest.length === 0)
+        return literal(k);
+
+    let r: estree.Expression;
+    if (!rest[0].negative) {
+        r = rest[0].node;
+    } else if (k !== 0) {
+        r = binary('-', literal(k), rest[0].node);
+        k = 0;
+    } else {
+        r = { type: 'UnaryExpression', operator: '-', prefix: true, argument: rest[0].node };
+    }
+    for (const t of rest.slice(1))
+        r = binary(t.negative ? '-' : '+', r, t.node);
+    return k !== 0 ? binary('+', r, literal(k)) : r;
+}
+
+function reassociateProduct(node: estree.BinaryExpression, rewrites?: Rewrites): estree.Expression {
+    const terms: estree.Expression[] = [];
+    productTerms(node, terms);
+    let k = 1;
+    let constants = 0;
+    const rest: estree.Expression[] = [];
+    for (const t of terms) {
+        const v = constant(t);
+        if (v !== undefined) {
+            k *= v;
+            constants++;
+        } else {
+            rest.push(t);
+        }
+    }
+    if (constants === 0 || (constants === 1 && k !== 1))
+        return node;
+    countRewrite(rewrites, constants > 1 ? 'reassociation' : 'identity');
+    if (rest.length === 0)
+        return literal(k);
+
+    let r = rest[0];
+    for (const t of rest.slice(1))
+        r = binary('*', r, t);
+    if (k === -1)
+        return { type: 'UnaryExpression', operator: '-', prefix: true, argument: r };
+    return k !== 1 ? binary('*', r, literal(k)) : r;
+}
+
+function simplifyNode(node: estree.Node, rewrites?: Rewrites): estree.Node {
+    if (node.type === 'BinaryExpression') {
+        if (node.operator === '/') {
+            const k = constant(node.right);
+            if (k === 1) {
+                countRewrite(rewrites, 'identity');
+                return node.left;
+            }
+            if (k !== undefined && k !== 0 && Number.isFinite(1 / k)) {
+                countRewrite(rewrites, 'reciprocal');
+                const product = binary('*', node.left as estree.Expression, literal(1 / k));
+                return reassociateProduct(product as estree.BinaryExpression, rewrites);
+            }
+            return node;
+        }
+        if (node.operator === '+' || node.operator === '-')
+            return reassociateSum(node, rewrites);
+        if (node.operator === '*')
+            return reassociateProduct(node, rewrites);
+    }
+    const arg = isMathCall(node, 'exp') && node.arguments.length === 1 ? node.arguments[0] as estree.Node : undefined;
+    if (arg && isMathCall(arg, 'log') && arg.arguments.length === 1) {
+        countRewrite(rewrites, 'exp-log');
+        return arg.arguments[0] as estree.Expression;
+    }
+    return node;
+}
+
+// Bottom-up, the children are already simplified when their parent is
+function rewrite(node: estree.Node, rewrites?: Rewrites): estree.Node {
+    const children = node as unknown as Record<string, unknown>;
+    for (const key of Object.keys(children)) {
+        const child = children[key];
+        if (Array.isArray(child))
+            children[key] = child.map((c) => c && typeof c.type === 'string' ? rewrite(c, rewrites) : c);
+        else if (child && typeof child === 'object' && typeof (child as estree.Node).type === 'string')
+            children[key] = rewrite(child as estree.Node, rewrites);
+    }
+    return simplifyNode(node, rewrites);
+}
+
+export function simplifyAlgebra<T extends estree.Node>(node: T, rewrites?: Rewrites): T {
+    return rewrite(node, rewrites) as T;
+}
@@ -0,0 +1,33 @@
+import * as estree from 'estree';
+import { getGlobalConstant } from './variable';
+
+// The helpers of the passes that analyze or rewrite the syntax tree
+
+// A call is as expensive as this many arithmetic operations
+export const callCost = 10;
+
+// Negative literals too, so that the rewritten constants are literals for the shapes
+export function literal(value: number): estree.Expression {
+    return { type: 'Literal', value, raw: value.toString() };
+}
+
+export function binary(operator: estree.BinaryOperator, left: estree.Expression, right: estree.Expression):
+    estree.Expression {
+    return { type: 'BinaryExpression', operator, left, right };
+}
+
+// Math.name(...), any Math function without a name
+export function isMathCall(node: estree.Node, name?: string): node is estree.SimpleCallExpression {
+    return node.type === 'CallExpression' && node.callee.type === 'MemberExpression' &&
+        node.callee.object.type === 'Identifier' && node.callee.object.name === 'Math' &&
+        node.callee.property.type === 'Identifier' && (name === undefined || node.callee.property.name === name);
+}
+
+// The value of Math.PI and the like, undefined for the other member expressions
+export function globalConstant(node: estree.MemberExpression): number | undefined {
+    try {
+        return getGlobalConstant(node);
+    } catch (e) {
+        return undefined;
+    }
+}
@@ -0,0 +1,222 @@
+import { Instruction, OpCode, Unit } from '.';
+
+// The control flow graph and the dominator tree of the IR
+// for the passes that run after processFunction()
+
+export const branches: Set<OpCode> = new Set(['beq', 'bne', 'ubgt', 'ubge', 'ublt', 'ble', 'blt', 'bgt', 'bge'] as OpCode[]);
+
+// No side effects, the Math builtins are pure functions and the tables are constant
+export const pure: Set<OpCode> = new Set([
+    'add', 'sub', 'mul', 'div', 'mod', 'neg', 'fma',
+    'ext32', 'uext32', 'xor', 'lsh', 'rsh', 'ursh',
+    'sqrt', 'abs', 'floor', 'ceil', 'trunc',
+    'eq', 'ne', 'lt', 'gt', 'le', 'ge', 'ult', 'load',
+    'i2d', 'i2f', 'd2i', 'f2i', 'and', 'or', 'sel', 'call'
+] as OpCode[]);
+
+export interface Block {
+    text: Instruction[];
+    succ: number[];
+    pred: number[];
+    // immediate dominator, -1 for the entry and the unreachable blocks
+    idom: number;
+    depth: number;
+    reachable: boolean;
+    children: number[];
+    // dominator tree interval, a dominates b when it contains the interval of b
+    enter: number;
+    exit: number;
+}
+
+export interface Position {
+    block: number;
+    index: number;
+}
+
+export function isJump(insn: Instruction): boolean {
+    return insn.op === 'jmp' || insn.op === 'switch' || branches.has(insn.op);
+}
+
+// The labels of a jump, a switch has its index and then the table
+export function jumpTargets(insn: Instruction): string[] {
+    if (insn.op === 'switch')
+        return (insn.input as string[]).slice(1);
+    return [insn.output as string];
+}
+
+// The name written by an instruction, a call writes its second operand
+export function defined(insn: Instruction): string | undefined {
+    if (insn.op === 'call')
+        return insn.input && insn.input[1];
+    if (insn.op === 'label' || isJump(insn))
+        return undefined;
+    return insn.output;
+}
+
+export function used(insn: Instruction): string[] {
+    if (!insn.input)
+        return [];
+    if (insn.op === 'switch')
+        return insn.input.slice(0, 1);
+    return insn.op === 'call' ? insn.input.slice(2) : insn.input;
+}
+
+export function buildBlocks(text: Instruction[]): Block[] {
+    const blocks: Block[] = [];
+    const labels: Record<string, number> = {};
+    let current: Block | undefined;
+    const newBlock = () => {
+        current = { text: [], succ: [], pred: [], idom: -1, depth: 0, reachable: false, children: [],
+            enter: 0, exit: 0 };
+        blocks.push(current);
+        return current;
+    };
+    newBlock();
+    for (const insn of text) {
+        if (insn.op === 'label' && (current as Block).text.length > 0)
+            newBlock();
+        if (insn.op === 'label')
+            labels[insn.output as string] = blocks.length - 1;
+        (current as Block).text.push(insn);
+        if (isJump(insn))
+            newBlock();
+    }
+
+    blocks.forEach((b, i) => {
+        const last = b.text[b.text.length - 1];
+        if (last && isJump(last)) {
+            for (const target of jumpTargets(last))
+                if (labels[target] !== undefined && !b.succ.includes(labels[target]))
+                    b.succ.push(labels[target]);
+            if (last.op !== 'jmp' && last.op !== 'switch' && i + 1 < blocks.length)
+                b.succ.push(i + 1);
+        } else if (i + 1 < blocks.length) {
+            b.succ.push(i + 1);
+        }
+    });
+    return blocks;
+}
+
+// Cooper, Harvey and Kennedy, "A Simple, Fast Dominance Algorithm"
+export function computeDominators(blocks: Block[]): void {
+    const order: number[] = [];
+    const stack: { block: number, next: number }[] = [{ block: 0, next: 0 }];
+    blocks[0].reachable = true;
+    while (stack.length) {
+        const top = stack[stack.length - 1];
+        const succ = blocks[top.block].succ;
+        if (top.next < succ.length) {
+            const s = succ[top.next++];
+            if (!blocks[s].reachable) {
+                blocks[s].reachable = true;
+                stack.push({ block: s, next: 0 });
+            }
+        } else {
+            order.push(top.block);
+            stack.pop();
+        }
+    }
+    order.reverse();
+    const rpo: number[] = [];
+    order.forEach((b, i) => rpo[b] = i);
+    blocks.forEach((b, i) => {
+        if (b.reachable)
+            for (const s of b.succ)
+                blocks[s].pred.push(i);
+    });
+
+    const idom: number[] = blocks.map(() => -1);
+    idom[0] = 0;
+    const intersect = (a: number, b: number): number => {
+        while (a !== b) {
+            while (rpo[a] > rpo[b]) a = idom[a];
+            while (rpo[b] > rpo[a]) b = idom[b];
+        }
+        return a;
+    };
+    let changed = true;
+    while (changed) {
+        changed = false;
+        for (const b of order.slice(1)) {
+            let dom = -1;
+            for (const p of blocks[b].pred)
+                if (idom[p] !== -1)
+                    dom = dom === -1 ? p : intersect(p, dom);
+            if (dom !== idom[b]) {
+                idom[b] = dom;
+                changed = true;
+            }
+        }
+    }
+
+    for (const b of order.slice(1)) {
+        blocks[b].idom = idom[b];
+        blocks[b].depth = blocks[idom[b]].depth + 1;
+        blocks[idom[b]].children.push(b);
+    }
+
+    let clock = 0;
+    const walk: { block: number, next: number }[] = [{ block: 0, next: 0 }];
+    blocks[0].enter = clock++;
+    while (walk.length) {
+        const top = walk[walk.length - 1];
+        const children = blocks[top.block].children;
+        if (top.next < children.length) {
+            const c = children[top.next++];
+            blocks[c].enter = clock++;
+            walk.push({ block: c, next: 0 });
+        } else {
+            blocks[top.block].exit = clock++;
+            walk.pop();
+        }
+    }
+}
+
+export function dominates(blocks: Block[], a: number, b: number): boolean {
+    if (!blocks[a].reachable || !blocks[b].reachable)
+        return false;
+    return blocks[a].enter <= blocks[b].enter && blocks[b].exit <= blocks[a].exit;
+}
+
+export function commonDominator(blocks: Block[], a: number, b: number): number {
+    while (blocks[a].depth > blocks[b].depth) a = blocks[a].idom;
+    while (blocks[b].depth > blocks[a].depth) b = blocks[b].idom;
+    while (a !== b) {
+        a = blocks[a].idom;
+        b = blocks[b].idom;
+    }
+    return a;
+}
+
+export function before(blocks: Block[], def: Position, use: Position): boolean {
+    if (def.block === use.block)
+        return def.index < use.index;
+    return dominates(blocks, def.block, use.block);
+}
+
+// The names assigned once by an instruction that dominates all their uses,
+// they hold the same value everywhere and can be treated as SSA values
+export function singleAssignments(code: Unit, blocks: Block[]):
+    { defs: Map<string, Position[]>, stable: Map<string, Position> } {
+    const defs = new Map<string, Position[]>();
+    blocks.forEach((b, block) => b.text.forEach((insn, index) => {
+        const d = defined(insn);
+        if (d !== undefined) {
+            if (!defs.has(d))
+                defs.set(d, []);
+            (defs.get(d) as Position[]).push({ block, index });
+        }
+    }));
+    const stable = new Map<string, Position>();
+    for (const [name, positions] of defs)
+        if (positions.length === 1 && code.params[name] === undefined && blocks[positions[0].block].reachable)
+            stable.set(name, positions[0]);
+    blocks.forEach((b, block) => b.reachable && b.text.forEach((insn, index) => {
+        for (const u of used(insn)) {
+            const def = stable.get(u);
+            if (def && !before(blocks, def, { block, index }))
+                stable.delete(u);
+        }
+    }));
+    return { defs, stable };
+}
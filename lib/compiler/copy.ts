@@ -0,0 +1,110 @@
+import { Instruction, Unit } from '.';
+import { Position, pure, defined, used, buildBlocks, computeDominators, singleAssignments } from './cfg';
+
+// Copy propagation and dead temporary elimination on the IR.
+//
+// The front end moves every intermediate result to a new local and every
+// declared variable is a copy of the temporary holding its initializer.
+// A copy of a name that keeps its value - a parameter that is never assigned,
+// a constant or a single assignment - is replaced by the original everywhere.
+// A copy of a variable that is assigned again only within its own block
+// and before the next assignment. The instructions that compute a temporary
+// that is never read are removed and a temporary that is only copied to
+// a variable is replaced by the variable. MIR would do it too but every
+// local it sees costs compile time.
+
+// read by the epilogue and by the map() loop
+const implicit = '_return_value';
+
+export function propagateCopies(code: Unit): void {
+    const blocks = buildBlocks(code.text);
+    computeDominators(blocks);
+    const { defs, stable } = singleAssignments(code, blocks);
+
+    const kind = (s: string) => code.params[s] || code.variables[s] ||
+        (code.constants[s] !== undefined ? 'value' : undefined);
+    const fixed = (s: string) => (code.params[s] !== undefined && !defs.has(s)) || stable.has(s);
+
+    const uses = new Map<string, Position[]>();
+    blocks.forEach((b, block) => b.text.forEach((insn, index) => {
+        for (const u of used(insn)) {
+            if (!uses.has(u))
+                uses.set(u, []);
+            (uses.get(u) as Position[]).push({ block, index });
+        }
+    }));
+
+    const rename = new Map<string, string>();
+    const resolve = (s: string): string => {
+        while (rename.has(s))
+            s = rename.get(s) as string;
+        return s;
+    };
+    const deleted = new Set<Instruction>();
+    blocks.forEach((b, block) => b.reachable && b.text.forEach((insn, index) => {
+        if (insn.op !== 'mov' || insn.offset !== undefined || !insn.input || insn.output === undefined)
+            return;
+        const t = insn.output;
+        const s = resolve(insn.input[0]);
+        if (t === implicit || !stable.has(t) || kind(s) === undefined || kind(s) !== kind(t))
+            return;
+        if (!fixed(s)) {
+            const copies = uses.get(t) || [];
+            if (copies.some((u) => u.block !== block))
+                return;
+            const last = Math.max(index, ...copies.map((u) => u.index));
+            if (b.text.slice(index + 1, last).some((i) => defined(i) === s))
+                return;
+        }
+        rename.set(t, s);
+        deleted.add(insn);
+    }));
+
+    const text = code.text.filter((insn) => !deleted.has(insn)).map((insn) => {
+        if (!insn.input || !insn.input.some((s) => rename.has(s)))
+            return insn;
+        const skip = insn.op === 'call' ? 2 : 0;
+        return { ...insn, input: insn.input.map((s, i) => i < skip ? s : resolve(s)) };
+    });
+
+    // the dead temporaries, the last ones first so that their inputs die too
+    const count = new Map<string, number>();
+    for (const insn of text)
+        for (const u of used(insn))
+            count.set(u, (count.get(u) || 0) + 1);
+    const dead = new Set<Instruction>();
+    const removed = [...rename.keys()];
+    for (let i = text.length - 1; i >= 0; i--) {
+        const insn = text[i];
+        const d = defined(insn);
+        if (d === undefined || d === implicit || code.variables[d] === undefined || !stable.has(d) || count.get(d) ||
+            insn.offset !== undefined || (insn.op !== 'mov' && !pure.has(insn.op)))
+            continue;
+        dead.add(insn);
+        removed.push(d);
+        for (const u of used(insn))
+            count.set(u, (count.get(u) as number) - 1);
+    }
+
+    // op t, a, b followed by mov v, t where t is not read again is op v, a, b
+    code.text = [];
+    for (const insn of text.filter((insn) => !dead.has(insn))) {
+        const prev = code.text[code.text.length - 1];
+        const t = prev && defined(prev);
+        if (t !== undefined && insn.op === 'mov' && insn.offset === undefined && insn.input && insn.input[0] === t &&
+            insn.output !== undefined && insn.output !== t && code.variables[t] !== undefined && t !== implicit &&
+            stable.has(t) && count.get(t) === 1 && kind(insn.output) === kind(t)) {
+            code.text[code.text.length - 1] = prev.op === 'call' ?
+                { ...prev, input: (prev.input as string[]).map((s, i) => i === 1 ? insn.output as string : s) } :
+                { ...prev, output: insn.output };
+            removed.push(t);
+            continue;
+        }
+        code.text.push(insn);
+    }
+    // a return at the end of the function jumps to the next instruction
+    code.text = code.text.filter((insn, i) => insn.op !== 'jmp' ||
+        !(code.text[i + 1] && code.text[i + 1].op === 'label' && code.text[i + 1].output === insn.output));
+    for (const name of removed)
+        delete code.variables[name];
+}
@@ -0,0 +1,204 @@
+import { Instruction, OpCode, Unit } from '.';
+import {
+    Position, pure, isJump, defined, used, buildBlocks, computeDominators, dominates, commonDominator, singleAssignments
+} from './cfg';
+
+// Common subexpression elimination on the IR of a function.
+//
+// MIR must treat every call as having side effects, here the Math builtins
+// are pure functions and their duplicate calls are removed too.
+//
+// Only the names assigned once, by an instruction that dominates all their
+// uses, take part: they hold the same value everywhere and can be value
+// numbered without SSA. An expression is replaced by an earlier one that
+// dominates it, the expressions computed on every path after a branch,
+// in both arms of a ternary for example, are hoisted before the branch.
+
+const commutative: Set<OpCode> = new Set(['add', 'mul', 'eq', 'ne', 'and', 'or', 'xor'] as OpCode[]);
+
+// A computation of an expression that is not dominated by another one
+interface Instance {
+    block: number;
+    insn: Instruction;
+    name: string;
+}
+
+export function eliminateCommonSubexpressions(code: Unit): void {
+    const blocks = buildBlocks(code.text);
+    computeDominators(blocks);
+    // the hoisted instructions, placed before the final branch of their block
+    const hoisted: Instruction[][] = blocks.map(() => []);
+
+    const isName = (s: string) => code.params[s] !== undefined || code.variables[s] !== undefined ||
+        code.constants[s] !== undefined;
+
+    const { defs, stable } = singleAssignments(code, blocks);
+    const available = (name: string, block: number): boolean =>
+        (code.params[name] !== undefined && !defs.has(name)) ||
+        (stable.has(name) && dominates(blocks, (stable.get(name) as Position).block, block));
+
+    // value numbers: the parameters, the literals and the expressions
+    const keys = new Map<string, number>();
+    const intern = (key: string): number => {
+        if (!keys.has(key))
+            keys.set(key, keys.size);
+        return keys.get(key) as number;
+    };
+    const values = new Map<string, number>();
+    const leader: string[] = [];
+    for (const p of Object.keys(code.params))
+        if (!defs.has(p)) {
+            values.set(p, intern(`param:${p}`));
+            leader[values.get(p) as number] = p;
+        }
+    const valueOf = (s: string): number | undefined => isName(s) ? values.get(s) : intern(`=${s}`);
+
+    const expressionKey = (insn: Instruction): string | undefined => {
+        const input = used(insn).map(valueOf);
+        if (input.some((v) => v === undefined))
+            return undefined;
+        const order = (a?: number, b?: number) => (a as number) - (b as number);
+        if (commutative.has(insn.op))
+            input.sort(order);
+        else if (insn.op === 'fma')
+            input.splice(0, 2, ...input.slice(0, 2).sort(order));
+        const op = insn.op === 'call' ? `call:${(insn.input as string[])[0]}` : insn.op;
+        return `${op}(${input.join(',')})`;
+    };
+
+    // dominator tree walk with the expressions available in the current block
+    const avail = new Map<number, string>();
+    const deleted = new Set<Instruction>();
+    const rename = new Map<string, string>();
+    const instances = new Map<number, Instance[]>();
+    const walk: { block: number, added?: number[] }[] = [{ block: 0 }];
+    while (walk.length) {
+        const top = walk[walk.length - 1];
+        if (top.added) {
+            for (const v of top.added)
+                avail.delete(v);
+            walk.pop();
+            continue;
+        }
+        top.added = [];
+        for (const insn of blocks[top.block].text) {
+            const d = defined(insn);
+            if (d === undefined || !stable.has(d))
+                continue;
+            const copy = insn.op === 'mov' && insn.offset === undefined && insn.input ? valueOf(insn.input[0]) : undefined;
+            const key = pure.has(insn.op) ? expressionKey(insn) : undefined;
+            if (copy !== undefined) {
+                values.set(d, copy);
+                if (leader[copy] === undefined)
+                    leader[copy] = d;
+            } else if (key !== undefined) {
+                const v = intern(key);
+                values.set(d, v);
+                if (avail.has(v)) {
+                    deleted.add(insn);
+                    rename.set(d, avail.get(v) as string);
+                } else {
+                    avail.set(v, d);
+                    top.added.push(v);
+                    if (leader[v] === undefined)
+                        leader[v] = d;
+                    if (!instances.has(v))
+                        instances.set(v, []);
+                    (instances.get(v) as Instance[]).push({ block: top.block, insn, name: d });
+                }
+            } else {
+                const v = intern(`def:${d}`);
+                values.set(d, v);
+                leader[v] = d;
+            }
+        }
+        for (const c of blocks[top.block].children.slice().reverse())
+            walk.push({ block: c });
+    }
+
+    // the same expression in blocks that do not dominate each other
+    const candidates = [...instances.keys()]
+        .filter((v) => (instances.get(v) as Instance[]).length > 1)
+        .sort((a, b) => a - b);
+    if (candidates.length) {
+        // anticipated: computed on every path from the end of the block
+        const gen = blocks.map(() => new Set<number>());
+        for (const v of candidates)
+            for (const i of instances.get(v) as Instance[])
+                gen[i.block].add(v);
+        const antIn = blocks.map((b, i) => b.succ.length ? new Set(candidates) : new Set(gen[i]));
+        const antOut = blocks.map(() => new Set<number>());
+        let changed = true;
+        while (changed) {
+            changed = false;
+            for (let b = blocks.length - 1; b >= 0; b--) {
+                if (!blocks[b].reachable)
+                    continue;
+                const out = new Set<number>();
+                const succ = blocks[b].succ;
+                if (succ.length)
+                    for (const v of antIn[succ[0]])
+                        if (succ.every((s) => antIn[s].has(v)))
+                            out.add(v);
+                const next = new Set([...out, ...gen[b]]);
+                if (next.size !== antIn[b].size)
+                    changed = true;
+                antOut[b] = out;
+                antIn[b] = next;
+            }
+        }
+
+        let cseId = 0;
+        for (const v of candidates) {
+            const list = instances.get(v) as Instance[];
+            const block = list.map((i) => i.block).reduce((a, b) => commonDominator(blocks, a, b));
+            if (!antOut[block].has(v))
+                continue;
+            const template = list[0].insn;
+            const input = (template.input as string[]).map((s, i) => {
+                if (template.op === 'call' && i < 2)
+                    return s;
+                if (!isName(s))
+                    return s;
+                return leader[values.get(s) as number];
+            });
+            if (input.some((s, i) => isName(s) && !(template.op === 'call' && i < 2) && !available(s, block)))
+                continue;
+
+            const name = `_cse_${cseId++}`;
+            code.variables[name] = code.variables[list[0].name];
+            if (template.op === 'call')
+                input[1] = name;
+            hoisted[block].push(template.op === 'call' ?
+                { ...template, input } : { ...template, output: name, input });
+            stable.set(name, { block, index: blocks[block].text.length });
+            leader[v] = name;
+            for (const i of list) {
+                deleted.add(i.insn);
+                rename.set(i.name, name);
+            }
+        }
+    }
+
+    const resolve = (s: string): string => {
+        while (rename.has(s))
+            s = rename.get(s) as string;
+        return s;
+    };
+    code.text = [];
+    blocks.forEach((b, i) => {
+        const text = b.text.filter((insn) => !deleted.has(insn)).map((insn) => {
+            if (!insn.input || !insn.input.some((s) => rename.has(s)))
+                return insn;
+            const skip = insn.op === 'call' ? 2 : 0;
+            return { ...insn, input: insn.input.map((s, i) => i < skip ? s : resolve(s)) };
+        });
+        const last = text.length && isJump(text[text.length - 1]) ? text.length - 1 : text.length;
+        text.splice(last, 0, ...hoisted[i].map((insn) => ({
+            ...insn, input: (insn.input as string[]).map((s, i) => insn.op === 'call' && i < 2 ? s : resolve(s))
+        })));
+        code.text.push(...text);
+    });
+    for (const name of rename.keys())
+        delete code.variables[name];
+}
@@ -0,0 +1,181 @@
+import * as estree from 'estree';
+import { Unit, OpCode } from '.';
+import { addConstant } from './variable';
+import { constantExponent } from './function';
+
+// Integer division and remainder by a constant without a div instruction:
+// the quotient is a multiplication by a magic number and a shift
+// (Granlund and Montgomery, Hacker's Delight chapter 10).
+// The 32-bit operands are extended to 64 bits so that the products fit.
+
+// BigInt() and not 1n, the compiler targets ES3
+const one = BigInt(1);
+const two32 = BigInt(2 ** 32);
+
+interface Magic {
+    m: bigint;
+    // floor(x * m / 2^shift)
+    shift: number;
+}
+
+// The divisor when it is an integer literal in the range of the type
+export function integerDivisor(code: Unit, node: estree.Node): number | undefined {
+    const d = constantExponent(node);
+    if (d === undefined || !Number.isInteger(d) || d === 0)
+        return undefined;
+    if (code.type === 'Uint32')
+        return d > 0 && d < 2 ** 32 ? d : undefined;
+    if (code.type === 'Int32')
+        return d >= -(2 ** 31) && d < 2 ** 31 ? d : undefined;
+    return undefined;
+}
+
+function log2(d: number): number | undefined {
+    const bits = d.toString(2);
+    return bits.lastIndexOf('1') === 0 ? bits.length - 1 : undefined;
+}
+
+// For 0 <= x < 2^32 with the smallest shift, m has 33 bits for some divisors
+function unsignedMagic(d: number): Magic {
+    const divisor = BigInt(d);
+    const s = (d - 1).toString(2).length;
+    for (let l = 0; ; l++) {
+        const p = one << BigInt(32 + l);
+        const m = p / divisor + one;
+        if (l === s || m * divisor - p <= one << BigInt(l))
+            return { m, shift: 32 + l };
+    }
+}
+
+// For -2^31 <= x < 2^31 and 0 < d < 2^31 not a power of two, the quotient
+// rounded down needs one more for the negative dividends, m has 32 bits
+function signedMagic(d: number): Magic {
+    const divisor = BigInt(d);
+    const t = BigInt(2 ** 31);
+    const anc = t - one - t % divisor;
+    let p = 32;
+    while ((one << BigInt(p)) <= anc * (divisor - (one << BigInt(p)) % divisor))
+        p++;
+    const two = one << BigInt(p);
+    return { m: (two + divisor - two % divisor) / divisor, shift: p };
+}
+
+// result = x / d or x % d, d is a nonzero integerDivisor()
+export function processConstantDivision(code: Unit, x: string, d: number, remainder: boolean, result: string): void {
+    const temp = (name: string): string => {
+        const t = `${result}_${name}`;
+        code.variables[t] = 'value';
+        return t;
+    };
+    const insn = (op: OpCode, output: string, input: string[]) => code.text.push({ op, raw: true, output, input });
+    const constant = (v: number | bigint) => addConstant(code, Number(v)).ref;
+
+    if (d === 1 || d === -1) {
+        if (remainder)
+            code.text.push({ op: 'mov', output: result, input: [constant(0)] });
+        else
+            code.text.push({ op: d > 0 ? 'mov' : 'neg', output: result, input: [x] });
+        return;
+    }
+
+    const signed = code.type === 'Int32';
+    const n = temp('x');
+    insn(signed ? 'ext32' : 'uext32', n, [x]);
+    const a = Math.abs(d);
+    const k = log2(a);
+    // |quotient|, the last instruction writes the result
+    const q = remainder || d < 0 ? temp('q') : result;
+
+    if (!signed) {
+        if (k !== undefined) {
+            insn(remainder ? 'and' : 'ursh', result, [n, remainder ? constant(a - 1) : k.toString()]);
+            return;
+        }
+        const { m, shift } = unsignedMagic(a);
+        const product = temp('mul');
+        if (m < two32) {
+            insn('mul', product, [n, constant(m)]);
+            insn('ursh', q, [product, shift.toString()]);
+        } else {
+            // x * m would overflow, it is (x + (x * (m - 2^32) >> 32)) >> (shift - 32)
+            const high = temp('high');
+            const sum = temp('sum');
+            insn('mul', product, [n, constant(m - two32)]);
+            insn('ursh', high, [product, '32']);
+            insn('add', sum, [high, n]);
+            insn('ursh', q, [sum, (shift - 32).toString()]);
+        }
+    } else {
+        const sign = temp('sign');
+        insn('rsh', sign, [n, '63']);
+        if (k !== undefined) {
+            // rounded towards zero with 2^k - 1 added to a negative dividend
+            const bias = temp('bias');
+            const sum = temp('sum');
+            insn('ursh', bias, [sign, (64 - k).toString()]);
+            insn('add', sum, [n, bias]);
+            insn('rsh', q, [sum, k.toString()]);
+        } else {
+            const { m, shift } = signedMagic(a);
+            const product = temp('mul');
+            const high = temp('high');
+            insn('mul', product, [n, constant(m)]);
+            insn('rsh', high, [product, shift.toString()]);
+            insn('sub', q, [high, sign]);
+        }
+    }
+
+    if (remainder) {
+        // x - x / |d| * |d| has the sign of x like in JavaScript
+        const multiple = temp('multiple');
+        insn('mul', multiple, [q, constant(a)]);
+        insn('sub', result, [n, multiple]);
+    } else if (d < 0) {
+        insn('neg', result, [q]);
+    }
+}
+
+// result = x / d or x % d for an integer d that is not a constant. The div instruction traps
+// on a zero divisor and on -2^31 / -1, they divide by 1 instead and the quotient is fixed:
+// JavaScript gives Infinity or NaN, 0 in an integer array, x / -1 is -x and x % -1 is 0
+export function processIntegerDivision(code: Unit, x: string, d: string, remainder: boolean, result: string): void {
+    const temp = (name: string): string => {
+        const t = `${result}_${name}`;
+        code.variables[t] = 'value';
+        return t;
+    };
+    const insn = (op: OpCode, output: string, input: string[]) => code.text.push({ op, raw: true, output, input });
+
+    const signed = code.type === 'Int32';
+    const n = temp('d');
+    insn(signed ? 'ext32' : 'uext32', n, [d]);
+    const zero = temp('zero');
+    insn('eq', zero, [n, '0']);
+    let unsafe = zero;
+    let minusOne: string | undefined;
+    if (signed) {
+        minusOne = temp('minus_one');
+        insn('eq', minusOne, [n, '-1']);
+        unsafe = temp('unsafe');
+        insn('or', unsafe, [zero, minusOne]);
+    }
+    const divisor = temp('divisor');
+    insn('sel', divisor, [unsafe, '1', n]);
+
+    // x % 1 is already 0
+    if (remainder) {
+        code.text.push({ op: 'mod', output: result, input: [x, divisor] });
+        return;
+    }
+
+    let q = temp('q');
+    code.text.push({ op: 'div', output: q, input: [x, divisor] });
+    if (minusOne) {
+        const negated = temp('neg');
+        const fixed = temp('fixed');
+        code.text.push({ op: 'neg', output: negated, input: [x] });
+        insn('sel', fixed, [minusOne, negated, q]);
+        q = fixed;
+    }
+    insn('sel', result, [zero, '0', q]);
+}
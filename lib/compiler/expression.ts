@@ -1,12 +1,29 @@
 import * as estree from 'estree';
 import { Unit, OpCode, Value, processNode } from '.';
 import { addConstant } from './variable';
+import { processCallExpression, processRemainder, powCall, constantExponent } from './function';
+import { integerDivisor, processConstantDivision, processIntegerDivision } from './division';
+import { selectable, selectAssignment } from './select';
+import {
+    isCounter, counterOperands, integerLiteral, processCounter, processCounterUpdate, conditionalJump
+} from './loop';
 
 const arithmeticOps: Record<string, OpCode> = {
     '+': 'add',
     '-': 'sub',
     '*': 'mul',
-    '/': 'div'
+    '/': 'div',
+    '%': 'mod'
+};
+
+// The 32-bit integer operators, only for Int32 and Uint32
+const bitwiseOps: Record<string, OpCode> = {
+    '&': 'and',
+    '|': 'or',
+    '^': 'xor',
+    '<<': 'lsh',
+    '>>': 'rsh',
+    '>>>': 'ursh'
 };
 
 const comparisonOps: Record<string, OpCode> = {
@@ -18,15 +35,46 @@ const comparisonOps: Record<string, OpCode> = {
     '<=': 'le'
 };
 
-function getExprId(code: Unit): number {
+// The branch taken when a comparison is true
+const branchOps: Record<string, OpCode> = {
+    '>': 'bgt',
+    '<': 'blt',
+    '==': 'beq',
+    '!=': 'bne',
+    '>=': 'bge',
+    '<=': 'ble'
+};
+
+// The comparison that is true when the other one is false,
+// only with equality for the floats as both are false with a NaN
+const oppositeOps: Record<string, string> = {
+    '>': '<=',
+    '<': '>=',
+    '==': '!=',
+    '!=': '==',
+    '>=': '<',
+    '<=': '>'
+};
+
+export function getExprId(code: Unit): number {
     if (!code.exprId) code.exprId = 0;
     return code.exprId++;
 }
 
 export function processIdentifier(code: Unit, v: estree.Identifier): Value {
+    if (code.tables && code.tables[v.name])
+        throw new TypeError(`The array ${v.name} can only be indexed`);
     if (!code.variables[v.name] && !code.params[v.name]) {
         throw new ReferenceError(`Undefined variable ${v.name}`);
     }
+    if (isCounter(code, v.name))
+        return processCounter(code, v.name);
+    // a parameter that is never assigned or a variable assigned only by its
+    // declaration cannot change before the value is used, the others are copied
+    const writes = (code.writes && code.writes[v.name]) || 0;
+    if (writes + (code.params[v.name] ? 1 : 0) <= 1)
+        return { ref: v.name };
+
     const id = getExprId(code);
     const temp = `_expr_${id}`;
     code.variables[temp] = 'value';
@@ -41,15 +89,63 @@ export function processIdentifier(code: Unit, v: estree.Identifier): Value {
 }
 
 export function processBinaryExpression(code: Unit, expr: estree.BinaryExpression): Value {
+    if (expr.operator === '**') return processCallExpression(code, powCall(expr.left, expr.right));
     if (arithmeticOps[expr.operator]) return processArithmeticExpression(code, expr);
     if (comparisonOps[expr.operator]) return processComparisonExpression(code, expr);
+    if (bitwiseOps[expr.operator]) return processBitwiseExpression(code, expr);
 
     throw new SyntaxError('invalid binary operation: ' + expr.operator);
 }
 
+// The shift count is taken modulo 32 like in JavaScript, a shift
+// by 32 or more is not the same on all the MIR targets
+export function processBitwiseExpression(code: Unit, expr: estree.BinaryExpression): Value {
+    if (!bitwiseOps[expr.operator])
+        throw new SyntaxError('invalid bitwise operation: ' + expr.operator);
+    if (code.type === 'Float64' || code.type === 'Float32')
+        throw new TypeError(`${expr.operator} is supported only by the integer types`);
+
+    const temp = `_expr_${getExprId(code)}`;
+    code.variables[temp] = 'value';
+
+    const left = processNode(code, expr.left);
+    if (!left) throw new SyntaxError('invalid left bitwise argument ' + expr.left);
+
+    const shift = expr.operator === '<<' || expr.operator === '>>' || expr.operator === '>>>';
+    const k = shift ? constantExponent(expr.right) : undefined;
+    let right: string;
+    if (k !== undefined && Number.isInteger(k)) {
+        right = (k & 31).toString();
+    } else {
+        const r = processNode(code, expr.right);
+        if (!r) throw new SyntaxError('invalid right bitwise argument ' + expr.right);
+        right = r.ref;
+        if (shift) {
+            right = `${temp}_count`;
+            code.variables[right] = 'value';
+            code.text.push({
+                op: 'and',
+                output: right,
+                input: [r.ref, '31']
+            });
+        }
+    }
+
+    code.text.push({
+        op: bitwiseOps[expr.operator],
+        output: temp,
+        input: [left.ref, right]
+    });
+    return { ref: temp };
+}
+
 export function processArithmeticExpression(code: Unit, expr: estree.BinaryExpression): Value {
     if (!arithmeticOps[expr.operator])
         throw new SyntaxError('invalid arithmetic operation: ' + expr.operator);
+    if (code.fma && (code.type === 'Float64' || code.type === 'Float32') &&
+        (expr.operator === '+' || expr.operator === '-') &&
+        (isProduct(expr.left) || isProduct(expr.right)))
+        return processMultiplyAdd(code, expr);
 
     const id = getExprId(code);
     const temp = `_expr_${id}`;
@@ -58,9 +154,24 @@ export function processArithmeticExpression(code: Unit, expr: estree.BinaryExpre
     const left = processNode(code, expr.left);
     if (!left) throw new SyntaxError('invalid left binary argument ' + expr.left);
 
+    const divisor = expr.operator === '/' || expr.operator === '%' ? integerDivisor(code, expr.right) : undefined;
+    if (divisor !== undefined) {
+        processConstantDivision(code, left.ref, divisor, expr.operator === '%', temp);
+        return { ref: temp };
+    }
+
     const right = processNode(code, expr.right);
     if (!right) throw new SyntaxError('invalid right binary argument ' + expr.right);
 
+    if (expr.operator === '%' && (code.type === 'Float64' || code.type === 'Float32')) {
+        processRemainder(code, left.ref, right.ref, temp);
+        return { ref: temp };
+    }
+    if ((expr.operator === '/' || expr.operator === '%') && (code.type === 'Int32' || code.type === 'Uint32')) {
+        processIntegerDivision(code, left.ref, right.ref, expr.operator === '%', temp);
+        return { ref: temp };
+    }
+
     code.text.push({
         op: arithmeticOps[expr.operator],
         output: temp,
@@ -69,16 +180,71 @@ export function processArithmeticExpression(code: Unit, expr: estree.BinaryExpre
     return { ref: temp };
 }
 
-export function processComparisonExpression(code: Unit, expr: estree.BinaryExpression): Value {
-    if (!comparisonOps[expr.operator])
-        throw new SyntaxError('invalid binary comparison: ' + expr.operator);
+function isProduct(node: estree.Node): node is estree.BinaryExpression {
+    return node.type === 'BinaryExpression' && node.operator === '*';
+}
 
+// a * b + c, c + a * b, a * b - c and c - a * b as one fused multiply-add,
+// the operands are still evaluated from left to right
+function processMultiplyAdd(code: Unit, expr: estree.BinaryExpression): Value {
     const id = getExprId(code);
-    const temp_i64 = `_expr_i64_${id}`;
     const temp = `_expr_${id}`;
-    code.variables[temp_i64] = 'offset';
     code.variables[temp] = 'value';
 
+    const operand = (node: estree.Node): string => {
+        const v = processNode(code, node);
+        if (!v) throw new SyntaxError('invalid multiply-add argument ' + node);
+        return v.ref;
+    };
+    const negate = (ref: string): string => {
+        const neg = `_expr_${id}_neg`;
+        code.variables[neg] = 'value';
+        code.text.push({
+            op: 'neg',
+            output: neg,
+            input: [ref]
+        });
+        return neg;
+    };
+
+    let a, b, c;
+    if (isProduct(expr.left)) {
+        a = operand(expr.left.left);
+        b = operand(expr.left.right);
+        c = operand(expr.right);
+        if (expr.operator === '-') c = negate(c);
+    } else {
+        const product = expr.right as estree.BinaryExpression;
+        c = operand(expr.left);
+        a = operand(product.left);
+        b = operand(product.right);
+        if (expr.operator === '-') a = negate(a);
+    }
+
+    code.text.push({
+        op: 'fma',
+        output: temp,
+        input: [a, b, c]
+    });
+    return { ref: temp };
+}
+
+// The 0 or 1 result of a comparison in an i64
+function processComparison(code: Unit, expr: estree.BinaryExpression): string {
+    const temp_i64 = `_expr_i64_${getExprId(code)}`;
+    code.variables[temp_i64] = 'offset';
+
+    const counters = counterOperands(code, expr);
+    if (counters) {
+        code.text.push({
+            op: comparisonOps[expr.operator],
+            raw: true,
+            output: temp_i64,
+            input: counters
+        });
+        return temp_i64;
+    }
+
     const left = processNode(code, expr.left);
     if (!left) throw new SyntaxError('invalid left comparison argument ' + expr.left);
 
@@ -90,6 +256,17 @@ export function processComparisonExpression(code: Unit, expr: estree.BinaryExpre
         output: temp_i64,
         input: [left.ref, right.ref]
     });
+    return temp_i64;
+}
+
+export function processComparisonExpression(code: Unit, expr: estree.BinaryExpression): Value {
+    if (!comparisonOps[expr.operator])
+        throw new SyntaxError('invalid binary comparison: ' + expr.operator);
+
+    const temp = `_expr_${getExprId(code)}`;
+    code.variables[temp] = 'value';
+
+    const temp_i64 = processComparison(code, expr);
     switch (code.type) {
         case 'Float64':
             code.text.push({
@@ -107,6 +284,12 @@ export function processComparisonExpression(code: Unit, expr: estree.BinaryExpre
                 input: [temp_i64]
             });
             break;
+        default:
+            code.text.push({
+                op: 'mov',
+                output: temp,
+                input: [temp_i64]
+            });
     }
     return { ref: temp };
 }
@@ -127,19 +310,11 @@ export function processLogicalExpression(code: Unit, expr: estree.LogicalExpress
         input: [left.ref]
     });
 
-    if (expr.operator == '&&') {
-        code.text.push({
-            op: 'beq',
-            output: end,
-            input: [temp, addConstant(code, 0).ref]
-        });
-    } else if (expr.operator == '||') {
-        code.text.push({
-            op: 'bne',
-            output: end,
-            input: [temp, addConstant(code, 0).ref]
-        });
-    } else
+    if (expr.operator == '&&')
+        processValueBranch(code, temp, end, false);
+    else if (expr.operator == '||')
+        processValueBranch(code, temp, end, true);
+    else
         throw new SyntaxError('?? is not supported');
 
     const right = processNode(code, expr.right);
@@ -164,24 +339,31 @@ export function processUnaryExpression(code: Unit, expr: estree.UnaryExpression)
     const temp = `_expr_${id}`;
     code.variables[temp] = 'value';
 
-    const arg = processNode(code, expr.argument);
-    if (!arg) throw new SyntaxError('invalid unary argument ' + expr.argument);
-
     if (expr.operator == '-') {
+        const arg = processNode(code, expr.argument);
+        if (!arg) throw new SyntaxError('invalid unary argument ' + expr.argument);
+
         code.text.push({
             op: 'neg',
             output: temp,
             input: [arg.ref]
         });
+    } else if (expr.operator == '~') {
+        if (code.type === 'Float64' || code.type === 'Float32')
+            throw new TypeError('~ is supported only by the integer types');
+        const arg = processNode(code, expr.argument);
+        if (!arg) throw new SyntaxError('invalid unary argument ' + expr.argument);
+
+        code.text.push({
+            op: 'xor',
+            output: temp,
+            input: [arg.ref, '-1']
+        });
     } else if (expr.operator == '!') {
         // logical not in MIR is cumbersome
         const to0 = `_expr_${id}_to0`;
         const to1 = `_expr_${id}_to1`;
-        code.text.push({
-            op: 'beq',
-            output: to1,
-            input: [arg.ref, addConstant(code, 0).ref]
-        });
+        processBranch(code, expr.argument, to1, false);
         code.text.push({
             op: 'mov',
             output: temp,
@@ -199,7 +381,7 @@ export function processUnaryExpression(code: Unit, expr: estree.UnaryExpression)
         code.text.push({
             op: 'mov',
             output: temp,
-            input: ['1.0']
+            input: [addConstant(code, 1).ref]
         });
         code.text.push({
             op: 'label',
@@ -211,24 +393,168 @@ export function processUnaryExpression(code: Unit, expr: estree.UnaryExpression)
     return { ref: temp };
 }
 
+// Jump to label when the truth value of test is `when`, the comparisons,
+// `&&`, `||` and `!` branch directly without computing a value
+export function processBranch(code: Unit, test: estree.Node, label: string, when: boolean): void {
+    if (test.type === 'BinaryExpression' && comparisonOps[test.operator]) {
+        const counters = counterOperands(code, test);
+        if (counters) {
+            code.text.push({
+                op: branchOps[when ? test.operator : oppositeOps[test.operator]],
+                raw: true,
+                output: label,
+                input: counters
+            });
+            return;
+        }
+
+        const left = processNode(code, test.left);
+        if (!left) throw new SyntaxError('invalid left comparison argument ' + test.left);
+
+        const right = processNode(code, test.right);
+        if (!right) throw new SyntaxError('invalid right comparison argument ' + test.right);
+
+        const float = code.type === 'Float64' || code.type === 'Float32';
+        if (when || !float || test.operator === '==' || test.operator === '!=') {
+            code.text.push({
+                op: branchOps[when ? test.operator : oppositeOps[test.operator]],
+                output: label,
+                input: [left.ref, right.ref]
+            });
+            return;
+        }
+        const skip = `_expr_${getExprId(code)}_skip`;
+        code.text.push({
+            op: branchOps[test.operator],
+            output: skip,
+            input: [left.ref, right.ref]
+        });
+        code.text.push({
+            op: 'jmp',
+            raw: true,
+            output: label
+        });
+        code.text.push({
+            op: 'label',
+            output: skip
+        });
+        return;
+    }
+
+    if (test.type === 'LogicalExpression' && test.operator !== '??') {
+        // a && b is false as soon as a is false, a || b is true as soon as a is true
+        if ((test.operator === '&&') !== when) {
+            processBranch(code, test.left, label, when);
+            processBranch(code, test.right, label, when);
+            return;
+        }
+        const skip = `_expr_${getExprId(code)}_skip`;
+        processBranch(code, test.left, skip, !when);
+        processBranch(code, test.right, label, when);
+        code.text.push({
+            op: 'label',
+            output: skip
+        });
+        return;
+    }
+
+    if (test.type === 'UnaryExpression' && test.operator === '!') {
+        processBranch(code, test.argument, label, !when);
+        return;
+    }
+
+    const value = processNode(code, test);
+    if (!value) throw new SyntaxError('invalid conditional test ' + test);
+
+    processValueBranch(code, value.ref, label, when);
+}
+
+// The truth value of test in an i64 without a branch, both sides of
+// `&&` and `||` are evaluated
+function processCondition(code: Unit, test: estree.Node): string {
+    if (test.type === 'BinaryExpression' && comparisonOps[test.operator])
+        return processComparison(code, test);
+
+    const temp_i64 = `_expr_i64_${getExprId(code)}`;
+    code.variables[temp_i64] = 'offset';
+    const logical = (op: OpCode, input: string[]) => code.text.push({ op, raw: true, output: temp_i64, input });
+
+    if (test.type === 'LogicalExpression' && test.operator !== '??') {
+        const left = processCondition(code, test.left);
+        const right = processCondition(code, test.right);
+        logical(test.operator === '&&' ? 'and' : 'or', [left, right]);
+        return temp_i64;
+    }
+
+    if (test.type === 'UnaryExpression' && test.operator === '!') {
+        logical('eq', [processCondition(code, test.argument), '0']);
+        return temp_i64;
+    }
+
+    const value = processNode(code, test);
+    if (!value) throw new SyntaxError('invalid conditional test ' + test);
+
+    const zero = addConstant(code, 0).ref;
+    if (code.type !== 'Float64' && code.type !== 'Float32') {
+        code.text.push({ op: 'ne', output: temp_i64, input: [value.ref, zero] });
+    } else {
+        // NaN is false
+        const negative = `${temp_i64}_lt`;
+        const positive = `${temp_i64}_gt`;
+        code.variables[negative] = 'offset';
+        code.variables[positive] = 'offset';
+        code.text.push({ op: 'lt', output: negative, input: [value.ref, zero] });
+        code.text.push({ op: 'gt', output: positive, input: [value.ref, zero] });
+        logical('or', [negative, positive]);
+    }
+    return temp_i64;
+}
+
+// Jump to label when the truth value of a number is `when`, NaN is false
+function processValueBranch(code: Unit, ref: string, label: string, when: boolean): void {
+    const zero = addConstant(code, 0).ref;
+    const branch = (op: OpCode, input: string[]) => code.text.push({ op, output: label, input });
+
+    if (code.type !== 'Float64' && code.type !== 'Float32')
+        branch(when ? 'bne' : 'beq', [ref, zero]);
+    else if (when) {
+        branch('blt', [ref, zero]);
+        branch('bgt', [ref, zero]);
+    } else {
+        branch('beq', [ref, zero]);
+        branch('bne', [ref, ref]);
+    }
+}
+
+// The test jumps to the consequent when it is true, a float comparison
+// with a NaN falls through to the alternate without a second branch
 export function processIfStatement(code: Unit, expr: estree.IfStatement): void {
-    const id = getExprId(code);
+    const select = selectAssignment(code, expr);
+    if (select) {
+        processAssignmentExpression(code, select);
+        return;
+    }
 
-    const elseLabel = `_cond_${id}_else`;
-    const endLabel = `_cond_${id}_end`;
+    const jump = conditionalJump(code, expr.consequent);
+    if (jump) {
+        processBranch(code, expr.test, jump, true);
+        if (expr.alternate)
+            processNode(code, expr.alternate);
+        return;
+    }
 
-    const test = processNode(code, expr.test);
-    if (!test) throw new SyntaxError('invalid conditional test ' + expr.test);
+    const id = getExprId(code);
 
-    code.text.push({
-        op: 'beq',
-        output: expr.alternate ? elseLabel : endLabel,
-        input: [test.ref, addConstant(code, 0).ref]
-    });
+    const thenLabel = `_cond_${id}_then`;
+    const endLabel = `_cond_${id}_end`;
 
-    processNode(code, expr.consequent);
+    if (!expr.alternate) {
+        processBranch(code, expr.test, endLabel, false);
+        processNode(code, expr.consequent);
+    } else {
+        processBranch(code, expr.test, thenLabel, true);
+        processNode(code, expr.alternate);
 
-    if (expr.alternate) {
         code.text.push({
             op: 'jmp',
             raw: true,
@@ -238,10 +564,10 @@ export function processIfStatement(code: Unit, expr: estree.IfStatement): void {
         code.text.push({
             op: 'label',
             raw: true,
-            output: elseLabel
+            output: thenLabel
         });
 
-        processNode(code, expr.alternate);
+        processNode(code, expr.consequent);
     }
 
     code.text.push({
@@ -255,26 +581,22 @@ export function processConditionalExpression(code: Unit, expr: estree.Conditiona
     const id = getExprId(code);
 
     const temp = `_cond_${id}`;
-    const elseLabel = `_cond_${id}_else`;
+    const thenLabel = `_cond_${id}_then`;
     const endLabel = `_cond_${id}_end`;
     code.variables[temp] = 'value';
 
-    const test = processNode(code, expr.test);
-    if (!test) throw new SyntaxError('invalid conditional test ' + expr.test);
+    if (selectable(code, expr.test, expr.consequent, expr.alternate))
+        return processSelect(code, expr, temp);
 
-    code.text.push({
-        op: 'beq',
-        output: elseLabel,
-        input: [test.ref, addConstant(code, 0).ref]
-    });
+    processBranch(code, expr.test, thenLabel, true);
 
-    const consequent = processNode(code, expr.consequent);
-    if (!consequent) throw new SyntaxError('invalid conditional consequent ' + expr.consequent);
+    const alternate = processNode(code, expr.alternate);
+    if (!alternate) throw new SyntaxError('invalid conditional alternate ' + expr.alternate);
 
     code.text.push({
         op: 'mov',
         output: temp,
-        input: [consequent.ref]
+        input: [alternate.ref]
     });
 
     code.text.push({
@@ -286,16 +608,16 @@ export function processConditionalExpression(code: Unit, expr: estree.Conditiona
     code.text.push({
         op: 'label',
         raw: true,
-        output: elseLabel
+        output: thenLabel
     });
 
-    const alternate = processNode(code, expr.alternate);
-    if (!alternate) throw new SyntaxError('invalid conditional alternate ' + expr.alternate);
+    const consequent = processNode(code, expr.consequent);
+    if (!consequent) throw new SyntaxError('invalid conditional consequent ' + expr.consequent);
 
     code.text.push({
         op: 'mov',
         output: temp,
-        input: [alternate.ref]
+        input: [consequent.ref]
     });
 
     code.text.push({
@@ -307,6 +629,24 @@ export function processConditionalExpression(code: Unit, expr: estree.Conditiona
     return { ref: temp };
 }
 
+// Both arms are computed and a conditional move picks one of them
+function processSelect(code: Unit, expr: estree.ConditionalExpression, temp: string): Value {
+    const test = processCondition(code, expr.test);
+
+    const consequent = processNode(code, expr.consequent);
+    if (!consequent) throw new SyntaxError('invalid conditional consequent ' + expr.consequent);
+
+    const alternate = processNode(code, expr.alternate);
+    if (!alternate) throw new SyntaxError('invalid conditional alternate ' + expr.alternate);
+
+    code.text.push({
+        op: 'sel',
+        output: temp,
+        input: [test, consequent.ref, alternate.ref]
+    });
+    return { ref: temp };
+}
+
 export function processUpdateExpression(code: Unit, expr: estree.UpdateExpression): Value {
     const id = getExprId(code);
     const temp = `_expr_${id}`;
@@ -314,6 +654,8 @@ export function processUpdateExpression(code: Unit, expr: estree.UpdateExpressio
     if (expr.argument.type !== 'Identifier') throw new TypeError('Update expression argument is not a variable');
     const arg = expr.argument.name;
     if (!arg) throw new TypeError('Update expression argument is not a variable');
+    if (isCounter(code, arg))
+        return processCounterUpdate(code, arg, expr.operator, 1, expr.prefix);
 
     if (!expr.prefix) {
         code.text.push({
@@ -327,13 +669,42 @@ export function processUpdateExpression(code: Unit, expr: estree.UpdateExpressio
     code.text.push({
         op: expr.operator === '++' ? 'add' : 'sub',
         output: arg,
-        input: [arg, '1.0']
+        input: [arg, addConstant(code, 1).ref]
     });
 
     return { ref: expr.prefix ? arg : temp };
 }
 
 export function processAssignmentExpression(code: Unit, expr: estree.AssignmentExpression): Value {
+    if (expr.operator === '**=') {
+        if (expr.left.type !== 'Identifier') throw new TypeError('Invalid left side of assignment');
+        const power = processCallExpression(code, powCall(expr.left, expr.right));
+        code.text.push({
+            op: 'mov',
+            output: expr.left.name,
+            input: [power.ref]
+        });
+        return { ref: expr.left.name };
+    }
+
+    if (expr.left.type === 'Identifier' && isCounter(code, expr.left.name))
+        return processCounterUpdate(code, expr.left.name, expr.operator, integerLiteral(expr.right) as number);
+
+    // x %= k, x /= k of the integers and x <<= k like x = x % k
+    const operator = expr.operator.slice(0, -1) as estree.BinaryOperator;
+    if (operator === '%' || bitwiseOps[operator] ||
+        (operator === '/' && code.type !== 'Float64' && code.type !== 'Float32')) {
+        if (expr.left.type !== 'Identifier') throw new TypeError('Invalid left side of assignment');
+        const value = processBinaryExpression(code,
+            { type: 'BinaryExpression', operator, left: expr.left, right: expr.right });
+        code.text.push({
+            op: 'mov',
+            output: expr.left.name,
+            input: [value.ref]
+        });
+        return { ref: expr.left.name };
+    }
+
     const right = processNode(code, expr.right);
     if (!right) throw new TypeError('Invalid right side of assignment ' + expr.right);
 
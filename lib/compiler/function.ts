@@ -1,8 +1,15 @@
 import * as estree from 'estree';
-import { Unit, Value, VarType, processNode } from '.';
+import { Unit, Value, VarType, OpCode, Precision, CompileOptions, Rewrites, processNode } from '.';
+import { addConstant, emitConstants } from './variable';
+import { countRewrite } from './algebra';
+import { inductionVariables } from './loop';
 
 let fnUid = 0;
-export function processFunction(node: estree.FunctionExpression | estree.ArrowFunctionExpression, type: VarType): Unit {
+export function processFunction(
+    node: estree.FunctionExpression | estree.ArrowFunctionExpression,
+    type: VarType,
+    options?: CompileOptions,
+    rewrites?: Rewrites): Unit {
     if (node.type !== 'FunctionExpression' && node.type !== 'ArrowFunctionExpression')
         throw new TypeError('Passed value is not a function expression');
     let body;
@@ -18,7 +25,17 @@ export function processFunction(node: estree.FunctionExpression | estree.ArrowFu
     } else {
         name = node.id.name;
     }
-    const code: Unit = { name, text: [], params: {}, variables: {}, imports: {}, constants: {}, type };
+    checkShadowing(body, new Set(node.params.map((p) => p.type === 'Identifier' ? p.name : '')));
+    const code: Unit = {
+        name, text: [], params: {}, variables: {}, imports: {}, constants: {}, type,
+        precision: options && options.precision,
+        fma: options && options.fma,
+        fastMath: options && options.fastMath,
+        branchless: options && options.branchless,
+        rewrites: options && options.fastMath ? rewrites : undefined,
+        writes: countWrites(body),
+        counters: type === 'Float64' || type === 'Float32' ? inductionVariables(body, node.params) : {}
+    };
     for (const p of node.params) {
         if (p.type !== 'Identifier')
             throw new SyntaxError('Function arguments must be identifiers');
@@ -29,23 +46,83 @@ export function processFunction(node: estree.FunctionExpression | estree.ArrowFu
         op: 'label',
         output: '_func_end'
     });
+    emitConstants(code);
     return code;
 }
 
-export const builtins: Record<string, { arg: number, c: string }> = {
+// The let and const declared directly in a block, a for or a switch
+function scopeDeclarations(node: estree.Node): string[] {
+    let statements: estree.Node[] = [];
+    if (node.type === 'BlockStatement')
+        statements = node.body;
+    else if (node.type === 'ForStatement' && node.init)
+        statements = [node.init];
+    else if (node.type === 'SwitchStatement')
+        statements = ([] as estree.Node[]).concat(...node.cases.map((c) => c.consequent));
+    const names: string[] = [];
+    for (const s of statements)
+        if (s.type === 'VariableDeclaration' && s.kind !== 'var')
+            for (const d of s.declarations)
+                if (d.id.type === 'Identifier')
+                    names.push(d.id.name);
+    return names;
+}
+
+// The variables are scoped to the function, a let or const that shadows a
+// parameter or a variable of an enclosing block would be the same variable
+function checkShadowing(node: estree.Node, visible: Set<string>): void {
+    const own = scopeDeclarations(node);
+    for (const name of own)
+        if (visible.has(name))
+            throw new SyntaxError(`${name} shadows a variable with the same name`);
+    if (own.length)
+        visible = new Set([...visible, ...own]);
+    for (const child of Object.values(node as unknown as Record<string, unknown>)) {
+        if (Array.isArray(child))
+            child.forEach((c) => c && typeof c.type === 'string' && checkShadowing(c, visible));
+        else if (child && typeof child === 'object' && typeof (child as estree.Node).type === 'string')
+            checkShadowing(child as estree.Node, visible);
+    }
+}
+
+// A declaration with an initializer is one write, the other
+// assignments count twice as they can follow a read
+function countWrites(node: estree.Node): Record<string, number> {
+    const writes: Record<string, number> = {};
+    const count = (name: string, n: number) => writes[name] = (writes[name] || 0) + n;
+    const visit = (n: estree.Node) => {
+        if (n.type === 'VariableDeclarator' && n.id.type === 'Identifier' && n.init)
+            count(n.id.name, 1);
+        else if (n.type === 'AssignmentExpression' && n.left.type === 'Identifier')
+            count(n.left.name, 2);
+        else if (n.type === 'UpdateExpression' && n.argument.type === 'Identifier')
+            count(n.argument.name, 2);
+        for (const child of Object.values(n as unknown as Record<string, unknown>)) {
+            if (Array.isArray(child))
+                child.forEach((c) => c && typeof c.type === 'string' && visit(c));
+            else if (child && typeof child === 'object' && typeof (child as estree.Node).type === 'string')
+                visit(child as estree.Node);
+        }
+    };
+    visit(node);
+    return writes;
+}
+
+// The inline builtins are compiled to MIR instructions instead of calls
+export const builtins: Record<string, { arg: number, c: string, inline?: boolean }> = {
     'Math.sin': { arg: 1, c: 'sin' },
     'Math.cos': { arg: 1, c: 'cos' },
     'Math.sinh': { arg: 1, c: 'sinh' },
     'Math.cosh': { arg: 1, c: 'cosh' },
     'Math.tan': { arg: 1, c: 'tan' },
     'Math.tanh': { arg: 1, c: 'tanh' },
-    'Math.sqrt': { arg: 1, c: 'sqrt' },
+    'Math.sqrt': { arg: 1, c: 'sqrt', inline: true },
     'Math.log': { arg: 1, c: 'log' },
     'Math.log2': { arg: 1, c: 'log2' },
     'Math.log10': { arg: 1, c: 'log10' },
     'Math.exp': { arg: 1, c: 'exp' },
     'Math.pow': { arg: 2, c: 'pow' },
-    'Math.abs': { arg: 1, c: 'abs' },
+    'Math.abs': { arg: 1, c: 'abs', inline: true },
     'Math.acos': { arg: 1, c: 'acos' },
     'Math.acosh': { arg: 1, c: 'acosh' },
     'Math.asin': { arg: 1, c: 'asin' },
@@ -53,12 +130,178 @@ export const builtins: Record<string, { arg: number, c: string }> = {
     'Math.atan': { arg: 1, c: 'atan' },
     'Math.atanh': { arg: 1, c: 'atanh' },
     'Math.atan2': { arg: 2, c: 'atan2' },
-    'Math.ceil': { arg: 1, c: 'ceil' },
-    'Math.floor': { arg: 1, c: 'floor' },
-    'Math.round': { arg: 1, c: 'round' },
-    'Math.trunc': { arg: 1, c: 'trunc' }
+    'Math.ceil': { arg: 1, c: 'ceil', inline: true },
+    'Math.floor': { arg: 1, c: 'floor', inline: true },
+    'Math.round': { arg: 1, c: 'round', inline: true },
+    'Math.trunc': { arg: 1, c: 'trunc', inline: true },
+    'Math.min': { arg: 2, c: 'min', inline: true },
+    'Math.max': { arg: 2, c: 'max', inline: true },
+    // x % y of the floats, not a name that can be called
+    '%': { arg: 2, c: 'fmod' }
+};
+
+// The polynomial approximations from src/fastmath.h
+const fastBuiltins: Record<string, { arg: number, c: string }> = {
+    'Math.sin': { arg: 1, c: 'fast_sin' },
+    'Math.cos': { arg: 1, c: 'fast_cos' },
+    'Math.exp': { arg: 1, c: 'fast_exp' },
+    'Math.log': { arg: 1, c: 'fast_log' }
+};
+
+// The variants of the vector programs that call libmvec, src/kernels-impl.h
+export const vectorBuiltins: Record<string, string> = {
+    'sin': 'vector_sin',
+    'cos': 'vector_cos',
+    'exp': 'vector_exp',
+    'log': 'vector_log',
+    'pow': 'vector_pow'
 };
 
+export function getBuiltin(name: string, precision?: Precision):
+    { arg: number, c: string, inline?: boolean } | undefined {
+    if (precision === 'fast' && fastBuiltins[name])
+        return fastBuiltins[name];
+    return builtins[name];
+}
+
+// Math.round() and Math.min()/Math.max() have no machine instruction
+// with the JavaScript semantics for the half-way cases, NaN and -0
+function processInlineBuiltin(code: Unit, fn: string, result: string, args: string[]): void {
+    const end = `${result}_end`;
+    const insn = (op: OpCode, output: string, input: string[]) => code.text.push({ op, output, input });
+
+    if (fn !== 'round' && fn !== 'min' && fn !== 'max') {
+        insn(fn as OpCode, result, args);
+        return;
+    }
+
+    const zero = addConstant(code, 0).ref;
+    switch (fn) {
+        case 'round': {
+            // floor(x) + 1 when the fraction is at least 0.5, a zero takes the sign of x
+            const frac = `${result}_frac`;
+            code.variables[frac] = 'value';
+            insn('floor', result, args);
+            insn('sub', frac, [args[0], result]);
+            insn('blt', end, [frac, addConstant(code, 0.5).ref]);
+            insn('add', result, [result, addConstant(code, 1).ref]);
+            insn('bne', end, [result, zero]);
+            insn('mul', result, [args[0], zero]);
+            break;
+        }
+        case 'min':
+        case 'max': {
+            const [a, b] = args;
+            const min = fn === 'min';
+            insn('mov', result, [a]);
+            insn(min ? 'blt' : 'bgt', end, [a, b]);
+            insn('mov', result, [b]);
+            insn(min ? 'bgt' : 'blt', end, [a, b]);
+            // equal or NaN: NaN propagates and this also picks the right one of +0 and -0
+            if (min) {
+                insn('neg', result, [a]);
+                insn('sub', result, [result, b]);
+                insn('neg', result, [result]);
+            } else {
+                insn('add', result, [a, b]);
+            }
+            insn('bne', end, [a, b]);
+            insn('beq', end, [a, zero]);
+            insn('mov', result, [a]);
+            break;
+        }
+    }
+    code.text.push({ op: 'label', output: end });
+}
+
+// a ** b is Math.pow(a, b)
+export function powCall(left: estree.Expression, right: estree.Expression): estree.CallExpression {
+    return {
+        type: 'CallExpression',
+        optional: false,
+        callee: {
+            type: 'MemberExpression',
+            object: { type: 'Identifier', name: 'Math' },
+            property: { type: 'Identifier', name: 'pow' },
+            computed: false,
+            optional: false
+        },
+        arguments: [left, right]
+    };
+}
+
+// The exponent of Math.pow() when it is a number literal
+export function constantExponent(node: estree.Node): number | undefined {
+    if (node.type === 'Literal' && typeof node.value === 'number')
+        return node.value;
+    if (node.type === 'UnaryExpression' && node.operator === '-' &&
+        node.argument.type === 'Literal' && typeof node.argument.value === 'number')
+        return -node.argument.value;
+    return undefined;
+}
+
+// Exponents that are exact as multiplications, Math.pow() is correctly rounded
+// and x * x * x is not. { fastMath: true } accepts any small integer.
+export function powChainExponent(n: number, fastMath?: boolean): boolean {
+    if (fastMath)
+        return Number.isInteger(n) && Math.abs(n) <= maxPowChain;
+    return n === 0 || n === 1 || n === 2 || n === -1;
+}
+const maxPowChain = 64;
+
+// The largest finite value, only -Infinity is below its opposite
+export function maxFinite(type: VarType): number {
+    return type === 'Float32' ? 3.4028234663852886e38 : Number.MAX_VALUE;
+}
+
+// Math.pow(x, n) with a constant exponent without calling pow()
+function processConstantPow(code: Unit, base: string, n: number, result: string): boolean {
+    const insn = (op: OpCode, output: string, input: string[]) => code.text.push({ op, output, input });
+
+    if (n === 0.5 || (n === -0.5 && code.fastMath)) {
+        const root = n > 0 ? result : `${result}_root`;
+        code.variables[root] = 'value';
+        if (code.fastMath) {
+            countRewrite(code.rewrites, 'pow');
+            insn('sqrt', root, [base]);
+        } else {
+            // Math.pow(-0, 0.5) is 0 and Math.pow(-Infinity, 0.5) is Infinity
+            const end = `${result}_end`;
+            insn('add', root, [base, addConstant(code, 0).ref]);
+            insn('sqrt', root, [root]);
+            insn('bge', end, [base, addConstant(code, -maxFinite(code.type)).ref]);
+            insn('neg', root, [base]);
+            code.text.push({ op: 'label', output: end });
+        }
+        if (n < 0)
+            insn('div', result, [addConstant(code, 1).ref, root]);
+        return true;
+    }
+    if (!powChainExponent(n, code.fastMath))
+        return false;
+    if (!powChainExponent(n))
+        countRewrite(code.rewrites, 'pow');
+
+    if (n === 0) {
+        // even for NaN
+        insn('mov', result, [addConstant(code, 1).ref]);
+        return true;
+    }
+    // square and multiply, from the highest bit
+    const power = n > 0 ? result : `${result}_power`;
+    code.variables[power] = 'value';
+    const bits = Math.abs(n).toString(2);
+    insn('mov', power, [base]);
+    for (let i = 1; i < bits.length; i++) {
+        insn('mul', power, [power, power]);
+        if (bits[i] === '1')
+            insn('mul', power, [power, base]);
+    }
+    if (n < 0)
+        insn('div', result, [addConstant(code, 1).ref, power]);
+    return true;
+}
+
 let callReturnId = 0;
 export function processCallExpression(code: Unit, expr: estree.CallExpression): Value {
     let name;
@@ -74,14 +317,15 @@ export function processCallExpression(code: Unit, expr: estree.CallExpression):
     } else {
         throw new SyntaxError('Indirect call expressions are not yet supported');
     }
-    if (builtins[name] === undefined)
+    const fn = getBuiltin(name, code.precision);
+    if (fn === undefined)
         throw new ReferenceError('Undefined function ' + name);
-    const fn = builtins[name];
     if (expr.arguments.length !== fn.arg)
         throw new TypeError(`${name} expects ${fn.arg} arguments`);
 
+    const exponent = name === 'Math.pow' ? constantExponent(expr.arguments[1] as estree.Node) : undefined;
     const args: Value[] = [];
-    for (const arg of expr.arguments) {
+    for (const arg of exponent === undefined ? expr.arguments : expr.arguments.slice(0, 1)) {
         const r = processNode(code, arg);
         if (!r) {
             throw new SyntaxError('Function argument evaluates to no value');
@@ -91,6 +335,15 @@ export function processCallExpression(code: Unit, expr: estree.CallExpression):
 
     const result = `_callret_${callReturnId++}`;
     code.variables[result] = 'value';
+    if (exponent !== undefined) {
+        if (processConstantPow(code, args[0].ref, exponent, result))
+            return { ref: result };
+        args.push(addConstant(code, exponent));
+    }
+    if (fn.inline) {
+        processInlineBuiltin(code, fn.c, result, args.map((a) => a.ref));
+        return { ref: result };
+    }
     code.text.push({
         op: 'call',
         raw: true,
@@ -102,6 +355,17 @@ export function processCallExpression(code: Unit, expr: estree.CallExpression):
     return { ref: result };
 }
 
+// The floating point remainder has no MIR instruction
+export function processRemainder(code: Unit, left: string, right: string, result: string): void {
+    code.text.push({
+        op: 'call',
+        raw: true,
+        output: '_p_fmod',
+        input: ['fmod', result, left, right]
+    });
+    code.imports['%'] = true;
+}
+
 export function processReturn(code: Unit, node: estree.ReturnStatement): void {
     if (node.argument) {
         const r = processNode(code, node.argument);
@@ -14,27 +14,73 @@ import {
 import { processFunction, processCallExpression, processReturn } from './function';
 import { processConstant, processGlobalConstant, processVariableDeclaration } from './variable';
 import { genModule } from './mir';
-import { generateMap } from './map';
-export { genModule };
+import { generateMap, MapOptions } from './map';
+import { generateVector, VectorProgram } from './vector';
+import { rewritePolynomials } from './polynomial';
+import { simplifyAlgebra } from './algebra';
+import { eliminateCommonSubexpressions } from './cse';
+import { propagateCopies } from './copy';
+import { Loop, processLoop, processLabeledStatement, processJump } from './loop';
+import { processSwitch } from './switch';
+import { Table, processMemberExpression } from './table';
+export { genModule, MapOptions, VectorProgram };
 
 export type JeetahFn = (...args: number[]) => number;
 
-export type OpCode = 'mov' | 'add' | 'mul' | 'sub' | 'div' | 'neg' |
+export type OpCode = 'mov' | 'add' | 'mul' | 'sub' | 'div' | 'mod' | 'neg' |
     'dmov' | 'dadd' | 'dmul' | 'dsub' | 'ddiv' |
     'fmov' | 'fadd' | 'fmul' | 'fsub' | 'fdiv' |
-    'ret' | 'jmp' | 'call' |
-    'i2f' | 'i2d' |
-    'beq' | 'bne' | 'ubgt' | 'ubge' | 'ublt' | 'ble' |
-    'eq' | 'ne' | 'lt' | 'gt' | 'le' | 'ge' |
+    'ret' | 'jmp' | 'call' | 'switch' |
+    'i2f' | 'i2d' | 'd2i' | 'f2i' |
+    'beq' | 'bne' | 'ubgt' | 'ubge' | 'ublt' | 'ble' | 'blt' | 'bgt' | 'bge' |
+    'sqrt' | 'abs' | 'floor' | 'ceil' | 'trunc' |
+    'and' | 'or' | 'xor' | 'fma' | 'sel' |
+    'ext32' | 'uext32' | 'lsh' | 'rsh' | 'ursh' |
+    'eq' | 'ne' | 'lt' | 'gt' | 'le' | 'ge' | 'ult' |
+    // an element of a table
+    'load' |
     'label';
 
 export type VarType = 'Float64' | 'Float32' | 'Uint32' | 'Int32';
 
+export type Precision = 'exact' | 'vector' | 'fast';
+
+// Expression-level options
+export interface CompileOptions {
+    // map() loop unrolling factor, chosen from the body size if omitted
+    unroll?: number;
+    // map() runs straight-line floating point expressions as vector programs,
+    // on by default unless an unroll factor is requested
+    vectorize?: boolean;
+    // 'vector' calls the libmvec variants of sin, cos, exp, log and pow in the
+    // vector programs, 'fast' replaces sin, cos, exp and log with polynomial
+    // approximations, their maximum error is listed in src/fastmath.h
+    precision?: Precision;
+    // contract a * b + c and a * b - c to fused multiply-adds, a single
+    // rounding that is faster and more accurate but not what JavaScript computes
+    fma?: boolean;
+    // allow the algebraic rewrites that change the result: the divisions by
+    // constants become multiplications, the constants are reassociated,
+    // the polynomials in one variable are evaluated in Horner form and
+    // Math.pow() with any small integer exponent becomes a chain of multiplications
+    fastMath?: boolean;
+    // a ternary or an if/else assigning a variable can compute both arms and
+    // select the result without a branch. By default this is done when the arms
+    // have no side effects and are cheap, true does it whenever they have no
+    // side effects and false always branches
+    branchless?: boolean;
+}
+
+// How many times each { fastMath: true } rewrite fired
+export type Rewrites = Record<string, number>;
+
 export interface Instruction {
     op: OpCode;
     output?: string;
     raw?: boolean;
     input?: string[];
+    // element offset for the pointer operands
+    offset?: number;
 }
 
 export type Variable = 'value' | 'pointer' | 'offset';
@@ -46,6 +92,21 @@ export interface Unit {
     variables: Record<string, Variable>;
     constants: Record<string, number>;
     imports: Record<string, boolean>;
+    // the name of the constant holding each value
+    constantRefs?: Map<number, string>;
+    // how many times each variable is assigned in the source
+    writes?: Record<string, number>;
+    precision?: Precision;
+    fma?: boolean;
+    fastMath?: boolean;
+    branchless?: boolean;
+    // the loop counters of the floating point functions, they are i64
+    counters?: Record<string, boolean>;
+    // the statements that break and continue can jump out of, innermost last
+    loops?: Loop[];
+    // the constant arrays
+    tables?: Record<string, Table>;
+    rewrites?: Rewrites;
     text: Instruction[];
     mirText?: string;
 
@@ -101,12 +162,35 @@ export function processNode(code: Unit, node: estree.Node): Value | undefined {
         case 'IfStatement':
             processIfStatement(code, node);
             return;
+        case 'ForStatement':
+        case 'WhileStatement':
+        case 'DoWhileStatement':
+            processLoop(code, node);
+            return;
+        case 'SwitchStatement':
+            processSwitch(code, node);
+            return;
+        case 'LabeledStatement':
+            processLabeledStatement(code, node);
+            return;
+        case 'BreakStatement':
+        case 'ContinueStatement':
+            processJump(code, node);
+            return;
+        case 'EmptyStatement':
+            return;
+        case 'SequenceExpression': {
+            let last: Value | undefined;
+            for (const e of node.expressions)
+                last = processNode(code, e);
+            return last;
+        }
         case 'ConditionalExpression':
             return processConditionalExpression(code, node);
         case 'Identifier':
             return processIdentifier(code, node);
         case 'MemberExpression':
-            return processGlobalConstant(code, node);
+            return processMemberExpression(code, node);
         case 'Literal':
             return processConstant(code, node);
         case 'CallExpression':
@@ -117,29 +201,51 @@ export function processNode(code: Unit, node: estree.Node): Value | undefined {
     }
 }
 
-export function compileBody(fn: JeetahFn, type: VarType): Unit {
+function parseFunction(fn: JeetahFn, type: VarType, options?: CompileOptions, rewrites?: Rewrites):
+    estree.FunctionExpression | estree.ArrowFunctionExpression {
     const ast = acorn.parseExpressionAt(fn.toString(), 0,
-        { ecmaVersion: 2015 }) as unknown as estree.FunctionExpression;
-    const code = processFunction(ast, type);
+        { ecmaVersion: 2016 }) as unknown as estree.FunctionExpression | estree.ArrowFunctionExpression;
+    if (options && options.fastMath && (type === 'Float64' || type === 'Float32'))
+        return rewritePolynomials(simplifyAlgebra(ast, rewrites), rewrites);
+    return ast;
+}
+
+// With { fastMath: true } code.rewrites is the report of the rewrites that fired
+export function compileBody(fn: JeetahFn, type: VarType, options?: CompileOptions): Unit {
+    const rewrites: Rewrites = {};
+    const code = processFunction(parseFunction(fn, type, options, rewrites), type, options, rewrites);
+    eliminateCommonSubexpressions(code);
+    propagateCopies(code);
     return code;
 }
 
-export function compile(fn: JeetahFn, type: VarType): Unit {
-    const code = compileBody(fn, type);
+export function compile(fn: JeetahFn, type: VarType, options?: CompileOptions): Unit {
+    const code = compileBody(fn, type, options);
     code.mirText = genModule(code);
     return code;
 }
 
-export function compileMap(fn: JeetahFn, type: VarType, iter: string): Unit {
-    const code = compileBody(fn, type);
-    generateMap(code, iter);
+export function compileMap(fn: JeetahFn, type: VarType, iter: string, options?: CompileOptions, length?: number): Unit {
+    const code = compileBody(fn, type, options);
+    generateMap(code, iter, { unroll: options && options.unroll, length });
     code.mirText = genModule(code);
     return code;
 }
 
+export function compileVector(fn: JeetahFn, type: VarType, iter: string, options?: CompileOptions):
+    VectorProgram | undefined {
+    if (options && (options.vectorize === false || options.unroll !== undefined))
+        return undefined;
+    const ast = parseFunction(fn, type, options);
+    if (ast.type !== 'FunctionExpression' && ast.type !== 'ArrowFunctionExpression')
+        return undefined;
+    return generateVector(ast, type, iter, options);
+}
+
 // eslint-disable-next-line @typescript-eslint/no-explicit-any
 (global as any)['Jeetah'] = {
     compile,
     compileBody,
-    compileMap
+    compileMap,
+    compileVector
 };
@@ -0,0 +1,225 @@
+import * as estree from 'estree';
+import { Unit, Value, OpCode, processNode } from '.';
+import { processBranch, getExprId } from './expression';
+import { constantExponent } from './function';
+import { processSwitch } from './switch';
+
+// Loops, break and continue.
+//
+// The test is at the bottom of the loop, after a jump to it on entry,
+// so that an iteration takes one conditional branch.
+//
+// The loop counters of the floating point functions are i64: a variable
+// declared with an integer literal and then incremented or assigned only
+// integer literals holds the same values as a double as long as they are
+// exact. The comparisons with the integer literals and the other counters
+// are integer branches and a counter is converted only when it is read
+// as a number.
+
+export interface Loop {
+    // the statement label
+    name?: string;
+    break: string;
+    // undefined for a switch and for a labeled statement that is not a loop
+    continue?: string;
+    // a labeled block, only a labeled break leaves it
+    block?: boolean;
+}
+
+// An integer literal that a double holds exactly, -0 is not an integer
+export function integerLiteral(node: estree.Node): number | undefined {
+    const v = constantExponent(node);
+    if (v === undefined || !Number.isSafeInteger(v) || Object.is(v, -0))
+        return undefined;
+    return v;
+}
+
+export function inductionVariables(node: estree.Node, params: estree.Node[]): Record<string, boolean> {
+    const counters: Record<string, boolean> = {};
+    const updated: Record<string, boolean> = {};
+    const excluded: Record<string, boolean> = {};
+    for (const p of params)
+        if (p.type === 'Identifier')
+            excluded[p.name] = true;
+
+    const visit = (n: estree.Node) => {
+        if (n.type === 'VariableDeclarator' && n.id.type === 'Identifier') {
+            if (n.init && integerLiteral(n.init) !== undefined)
+                counters[n.id.name] = true;
+            else
+                excluded[n.id.name] = true;
+        } else if (n.type === 'AssignmentExpression' && n.left.type === 'Identifier') {
+            if (!['=', '+=', '-='].includes(n.operator) || integerLiteral(n.right) === undefined)
+                excluded[n.left.name] = true;
+            updated[n.left.name] = true;
+        } else if (n.type === 'UpdateExpression' && n.argument.type === 'Identifier') {
+            updated[n.argument.name] = true;
+        }
+        for (const child of Object.values(n as unknown as Record<string, unknown>)) {
+            if (Array.isArray(child))
+                child.forEach((c) => c && typeof c.type === 'string' && visit(c));
+            else if (child && typeof child === 'object' && typeof (child as estree.Node).type === 'string')
+                visit(child as estree.Node);
+        }
+    };
+    visit(node);
+    // a variable that is never updated is a constant
+    for (const name of Object.keys(counters))
+        if (excluded[name] || !updated[name])
+            delete counters[name];
+    return counters;
+}
+
+export function isCounter(code: Unit, name: string): boolean {
+    return !!code.counters && !!code.counters[name];
+}
+
+// The value of a counter as a number of the function type
+export function processCounter(code: Unit, name: string): Value {
+    const temp = `_expr_${getExprId(code)}`;
+    code.variables[temp] = 'value';
+    code.text.push({
+        op: code.type === 'Float32' ? 'i2f' : 'i2d',
+        raw: true,
+        output: temp,
+        input: [name]
+    });
+    return { ref: temp };
+}
+
+// The i64 operands of a comparison between the counters and the integer literals
+export function counterOperands(code: Unit, expr: estree.BinaryExpression): string[] | undefined {
+    const operand = (n: estree.Node): string | undefined => {
+        if (n.type === 'Identifier')
+            return isCounter(code, n.name) ? n.name : undefined;
+        const v = integerLiteral(n);
+        return v === undefined ? undefined : v.toString();
+    };
+    const left = operand(expr.left);
+    const right = operand(expr.right);
+    if (left === undefined || right === undefined || !(isCounter(code, left) || isCounter(code, right)))
+        return undefined;
+    return [left, right];
+}
+
+// i++, i -= 2 or i = 0 of a counter, the value is converted only if it is read
+export function processCounterUpdate(code: Unit, name: string, operator: string, k: number, prefix = true): Value {
+    const previous = prefix ? undefined : processCounter(code, name);
+    const op: OpCode = operator === '=' ? 'mov' : operator[0] === '+' ? 'add' : 'sub';
+    code.text.push({
+        op,
+        raw: true,
+        output: name,
+        input: op === 'mov' ? [k.toString()] : [name, k.toString()]
+    });
+    return previous || processCounter(code, name);
+}
+
+// The truth value of a constant test, while (true) and for (;;)
+function constantTest(test: estree.Node | null | undefined): boolean | undefined {
+    if (!test)
+        return true;
+    if (test.type === 'Literal' && typeof test.value === 'boolean')
+        return test.value;
+    const k = constantExponent(test);
+    return k === undefined ? undefined : k !== 0 && !isNaN(k);
+}
+
+// A constant test is an unconditional jump or none
+function processLoopBranch(code: Unit, test: estree.Node | null | undefined, label: string): void {
+    const constant = constantTest(test);
+    if (constant === undefined) {
+        processBranch(code, test as estree.Node, label, true);
+    } else if (constant) {
+        code.text.push({
+            op: 'jmp',
+            raw: true,
+            output: label
+        });
+    }
+}
+
+type LoopStatement = estree.ForStatement | estree.WhileStatement | estree.DoWhileStatement;
+
+export function processLoop(code: Unit, node: LoopStatement, name?: string): void {
+    const id = getExprId(code);
+    const loop: Loop = { name, break: `_loop_${id}_end`, continue: `_loop_${id}_continue` };
+    const body = `_loop_${id}_body`;
+    const test = `_loop_${id}_test`;
+    const label = (output: string) => code.text.push({ op: 'label', output });
+
+    if (node.type === 'ForStatement' && node.init)
+        processNode(code, node.init);
+    if (node.type !== 'DoWhileStatement')
+        code.text.push({
+            op: 'jmp',
+            raw: true,
+            output: test
+        });
+
+    label(body);
+    if (!code.loops)
+        code.loops = [];
+    code.loops.push(loop);
+    processNode(code, node.body);
+    code.loops.pop();
+
+    label(loop.continue as string);
+    if (node.type === 'ForStatement' && node.update)
+        processNode(code, node.update);
+    label(test);
+    processLoopBranch(code, node.test, body);
+    label(loop.break);
+}
+
+export function processLabeledStatement(code: Unit, node: estree.LabeledStatement): void {
+    const stmt = node.body;
+    if (stmt.type === 'ForStatement' || stmt.type === 'WhileStatement' || stmt.type === 'DoWhileStatement') {
+        processLoop(code, stmt, node.label.name);
+        return;
+    }
+    if (stmt.type === 'SwitchStatement') {
+        processSwitch(code, stmt, node.label.name);
+        return;
+    }
+    const loop: Loop = { name: node.label.name, break: `_label_${getExprId(code)}_end`, block: true };
+    if (!code.loops)
+        code.loops = [];
+    code.loops.push(loop);
+    processNode(code, stmt);
+    code.loops.pop();
+    code.text.push({ op: 'label', output: loop.break });
+}
+
+// The label of a break or of a continue, acorn has already checked that it exists
+function jumpTarget(code: Unit, node: estree.BreakStatement | estree.ContinueStatement): string {
+    const loops = code.loops || [];
+    const brk = node.type === 'BreakStatement';
+    for (let i = loops.length - 1; i >= 0; i--) {
+        const loop = loops[i];
+        if (node.label ? loop.name === node.label.name : brk ? !loop.block : loop.continue !== undefined) {
+            const target = brk ? loop.break : loop.continue;
+            if (target === undefined)
+                break;
+            return target;
+        }
+    }
+    throw new SyntaxError(`Invalid ${brk ? 'break' : 'continue'} target`);
+}
+
+export function processJump(code: Unit, node: estree.BreakStatement | estree.ContinueStatement): void {
+    code.text.push({
+        op: 'jmp',
+        raw: true,
+        output: jumpTarget(code, node)
+    });
+}
+
+// if (c) break; is a single branch
+export function conditionalJump(code: Unit, stmt: estree.Statement): string | undefined {
+    if (stmt.type === 'BlockStatement' && stmt.body.length === 1)
+        stmt = stmt.body[0];
+    if (stmt.type === 'BreakStatement' || stmt.type === 'ContinueStatement')
+        return jumpTarget(code, stmt);
+    return undefined;
+}
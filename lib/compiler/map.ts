@@ -1,9 +1,116 @@
-import { Unit } from '.';
+import { Instruction, Unit } from '.';
 import { getInitEnd } from './variable';
+import { isJump } from './cfg';
+
+export interface MapOptions {
+    // specialize for arrays of exactly this length
+    length?: number;
+    // number of elements per loop iteration, a power of 2, chosen from the body size if omitted
+    unroll?: number;
+}
+
+// Maximum number of body instructions produced when unrolling
+const unrollBudget = 4096;
+
+// Automatic unrolling targets loop bodies of about this size
+const unrollTarget = 32;
+const unrollMax = 8;
+
+// A jump back to an earlier label
+function hasLoop(body: Instruction[]): boolean {
+    const labels = new Set<string | undefined>();
+    return body.some((op) => {
+        if (op.op === 'label')
+            labels.add(op.output);
+        return isJump(op) && labels.has(op.output);
+    });
+}
+
+// Cheap bodies are dominated by the loop overhead, but unrolling
+// bodies that call builtins or that loop only makes the code bigger
+function chooseUnroll(body: Instruction[]): number {
+    if (body.some((op) => op.op === 'call') || hasLoop(body))
+        return 1;
+    const size = body.filter((op) => op.op !== 'label').length + 2;
+    let factor = 1;
+    while (factor < unrollMax && factor * 2 * size <= unrollTarget)
+        factor *= 2;
+    return factor;
+}
+
+// Produce one copy of the loop body for the element at _iter + offset,
+// all its labels are renamed so that several copies can coexist
+function bodyCopy(body: Instruction[], input: string, offset: number, suffix: string): Instruction[] {
+    const labels = new Set(body.filter((op) => op.op === 'label').map((op) => op.output));
+    const rename = (s: string | undefined) => s !== undefined && labels.has(s) ? `${s}${suffix}` : s;
+
+    return [
+        // the SSA temporary
+        {
+            op: 'mov',
+            output: input,
+            input: ['_map_data'],
+            offset
+        },
+        ...body.map((op) => op.op === 'switch' ?
+            { ...op, input: (op.input as string[]).map((s, i) => i > 0 ? rename(s) as string : s) } :
+            { ...op, output: rename(op.output) }),
+        // store what was the return value in the result pointer
+        {
+            op: 'mov',
+            output: '_result',
+            input: ['_return_value'],
+            offset
+        }
+    ];
+}
+
+function generateFixedMap(code: Unit, body: Instruction[], input: string, length: number): Instruction[] {
+    const text: Instruction[] = [];
+
+    // fully unrolled if it fits, otherwise a loop unrolled as much as possible
+    let factor = length;
+    while (factor > 1 && factor * body.length > unrollBudget)
+        factor = factor >> 1;
+    const main = length - length % factor;
+
+    if (main > factor) {
+        text.push({
+            op: 'label',
+            output: '_func_start'
+        });
+    }
+    for (let i = 0; i < factor; i++)
+        text.push(...bodyCopy(body, input, i, `_${i}`));
+    if (main > factor) {
+        text.push({
+            op: 'add',
+            raw: true,
+            output: '_iter',
+            input: ['_iter', factor.toString()]
+        });
+        text.push({
+            op: 'ublt',
+            raw: true,
+            output: '_func_start',
+            input: ['_iter', main.toString()]
+        });
+    }
+
+    // the remainder is always straight-line code
+    const remainderBase = main > factor ? 0 : factor;
+    for (let i = 0; i < length - main; i++)
+        text.push(...bodyCopy(body, input, remainderBase + i, `_r${i}`));
+
+    code.name = `${code.name}_${length}`;
+
+    return text;
+}
 
 export function generateMap(
     code: Unit,
-    input: string) {
+    input: string,
+    options?: MapOptions) {
 
     if (!code.params[input])
         throw new ReferenceError(`Unknown argument ${input}`);
@@ -11,6 +118,10 @@ export function generateMap(
     if (code.params[input] !== 'value')
         throw new TypeError(`Cannot iterate over vector argument ${input}`);
 
+    const length = options && options.length;
+    if (length !== undefined && (!Number.isInteger(length) || length <= 0))
+        throw new RangeError(`Invalid fixed length ${length}`);
+
     // SSA for the iterator
     // see https://github.com/vnmakarov/mir/issues/260
     //
@@ -26,12 +137,9 @@ export function generateMap(
     code.variables['_iter'] = 'offset';
 
     const initEnd = getInitEnd(code);
-    // the SSA temporary
-    code.text.splice(initEnd + 1, 0, {
-        op: 'mov',
-        output: input,
-        input: ['_map_data']
-    });
+    // everything after _func_start is executed once per element
+    const body = code.text.splice(initEnd);
+    body.shift();
 
     code.variables['_iter_inc'] = 'offset';
 
@@ -43,21 +151,53 @@ export function generateMap(
         input: ['0']
     });
 
-    // instruction pointer is at the end of the loop (the single value body)
+    if (length !== undefined) {
+        code.text.push(...generateFixedMap(code, body, input, length));
+        return;
+    }
 
-    // store what was the return value in the result pointer
+    const unroll = options && options.unroll !== undefined ? options.unroll : chooseUnroll(body);
+    if (!Number.isInteger(unroll) || unroll < 1 || unroll > 64 || (unroll & (unroll - 1)))
+        throw new RangeError(`Invalid unroll factor ${unroll}`);
+
+    if (unroll > 1) {
+        code.variables['_map_main_length'] = 'offset';
+        code.text.push({
+            op: 'and',
+            raw: true,
+            output: '_map_main_length',
+            input: ['_map_data_length', (-unroll).toString()]
+        });
+    }
+    const mainLength = unroll > 1 ? '_map_main_length' : '_map_data_length';
+
+    // do not enter the loop on empty arrays
     code.text.push({
-        op: 'mov',
-        output: '_result',
-        input: ['_return_value']
+        op: 'ubge',
+        raw: true,
+        output: unroll > 1 ? '_map_tail' : '_map_end',
+        input: ['_iter', mainLength]
     });
 
+    code.text.push({
+        op: 'label',
+        output: '_func_start'
+    });
+
+    if (unroll > 1) {
+        for (let i = 0; i < unroll; i++)
+            code.text.push(...bodyCopy(body, input, i, `_${i}`));
+    } else {
+        // the single value body, the labels remain unchanged
+        code.text.push(...bodyCopy(body, input, 0, ''));
+    }
+
     // increment the iterator
     code.text.push({
         op: 'add',
         raw: true,
         output: '_iter',
-        input: ['_iter', '1']
+        input: ['_iter', unroll.toString()]
     });
 
     // end of the loop?
@@ -65,6 +205,42 @@ export function generateMap(
         op: 'ublt',
         raw: true,
         output: '_func_start',
-        input: ['_iter', '_map_data_length']
+        input: ['_iter', mainLength]
+    });
+
+    // the remaining elements are processed one by one
+    if (unroll > 1) {
+        code.text.push({
+            op: 'label',
+            output: '_map_tail'
+        });
+        code.text.push({
+            op: 'ubge',
+            raw: true,
+            output: '_map_end',
+            input: ['_iter', '_map_data_length']
+        });
+        code.text.push({
+            op: 'label',
+            output: '_map_tail_start'
+        });
+        code.text.push(...bodyCopy(body, input, 0, '_t'));
+        code.text.push({
+            op: 'add',
+            raw: true,
+            output: '_iter',
+            input: ['_iter', '1']
+        });
+        code.text.push({
+            op: 'ublt',
+            raw: true,
+            output: '_map_tail_start',
+            input: ['_iter', '_map_data_length']
+        });
+    }
+
+    code.text.push({
+        op: 'label',
+        output: '_map_end'
     });
 }
@@ -1,5 +1,7 @@
 import { Instruction, Unit, VarType } from '.';
-import { builtins } from './function';
+import { getBuiltin } from './function';
+import { formatConstant } from './variable';
+import { tableData } from './table';
 
 export type OpPrefix = 'f' | 'd' | 'u' | '';
 export type OpType = 'f' | 'd' | 'u32' | 'i32' | 'i64' | 'u64';
@@ -47,14 +49,17 @@ export function moduleHeader(code: Unit): string {
     let mir = `m_${code.name}:\tmodule\n`;
 
     for (const imp of Object.keys(code.imports)) {
-        mir += `_p_${builtins[imp].c}:\tproto ${opType[code.type]}`;
-        if (builtins[imp].arg > 0) {
-            for (let i = 0; i < builtins[imp].arg; i++)
+        const fn = getBuiltin(imp, code.precision);
+        if (!fn) continue;
+        mir += `_p_${fn.c}:\tproto ${opType[code.type]}`;
+        if (fn.arg > 0) {
+            for (let i = 0; i < fn.arg; i++)
                 mir += `, ${opType[code.type]}:arg${i}`;
         }
         mir += '\n';
-        mir += `import\t${builtins[imp].c}\n`;
+        mir += `import\t${fn.c}\n`;
     }
+    mir += tableData(code, opType[code.type], (v) => formatConstant(code, v));
 
     return mir;
 }
@@ -112,15 +117,21 @@ export function functionEpilogue(code: Unit): string {
 function getSymbol(code: Unit, op: Instruction, symbol: string): string {
     const s = code.params[symbol] || code.variables[symbol];
     if (op.raw || !s) return symbol;
-    if (s === 'pointer') return `${opType[code.type]}:(${symbol}, _iter, ${opSize[code.type].toString()})`;
+    if (s === 'pointer') {
+        const disp = op.offset ? (op.offset * opSize[code.type]).toString() : '';
+        return `${opType[code.type]}:${disp}(${symbol}, _iter, ${opSize[code.type].toString()})`;
+    }
     return symbol;
 }
 
+// The instructions that are the same for the signed and the unsigned integers
+const uint32Ops = ['mul', 'add', 'sub', 'neg', 'beq', 'bne', 'eq', 'ne', 'and', 'or', 'xor', 'lsh', 'rsh', 'ursh'];
+
 function getOpCode(code: Unit, op: Instruction): string {
     if (op.raw) return op.op;
-    if (op.op === 'mov' && code.type != 'Float32' && code.type != 'Float64')
+    if (['mov', 'sel', 'ext32', 'uext32'].includes(op.op) && code.type != 'Float32' && code.type != 'Float64')
         return op.op;
-    if (['mul', 'add', 'sub', 'beq', 'bne'].includes(op.op) && code.type == 'Uint32')
+    if (uint32Ops.includes(op.op) && code.type == 'Uint32')
         return op.op + opSuffix[code.type];
     return opPrefix[code.type] + op.op + opSuffix[code.type];
 }
@@ -134,13 +145,18 @@ export function functionText(code: Unit): string {
             mir += `${op.output}:\n`;
             continue;
         }
+        if (op.op === 'load') {
+            // base + index * size
+            const [base, index] = op.input as string[];
+            mir += `\t\t${getOpCode(code, { ...op, op: 'mov' })}\t${op.output}, ` +
+                `${opType[code.type]}:(${base}, ${index}, ${opSize[code.type]})\n`;
+            continue;
+        }
         mir += `\t\t${getOpCode(code, op)}`;
-        if (op.output)
-            mir += `\t${getSymbol(code, op, op.output)}`;
-        if (op.input && op.input.length)
-            for (const i of op.input) {
-                mir += `, ${getSymbol(code, op, i)}`;
-            }
+        // a switch has no output
+        const operands = (op.output ? [op.output] : []).concat(op.input || []);
+        if (operands.length)
+            mir += '\t' + operands.map((s) => getSymbol(code, op, s)).join(', ');
         mir += '\n';
     }
 
@@ -0,0 +1,174 @@
+import * as estree from 'estree';
+import { Rewrites } from '.';
+import { countRewrite } from './algebra';
+import { callCost, literal, binary, isMathCall, globalConstant } from './ast';
+
+// { fastMath: true } rewrites the polynomials in one variable to Horner form,
+// x*x*x*a + x*x*b + x*c + d becomes ((a*x + b)*x + c)*x + d
+
+// Only the sums of monomials are rewritten: expanding (x - 1000) ** 3 or
+// (x + 1) * (x - 1) would cancel catastrophically near their roots
+const maxDegree = 16;
+
+interface Polynomial {
+    // the variable, undefined for a constant
+    x?: string;
+    // coefficients, lowest degree first
+    c: number[];
+}
+
+function isConstant(p: Polynomial): boolean {
+    return p.c.length === 1;
+}
+
+function isMonomial(p: Polynomial): boolean {
+    return p.c.filter((v) => v !== 0).length <= 1;
+}
+
+function trim(c: number[]): number[] {
+    while (c.length > 1 && c[c.length - 1] === 0)
+        c.pop();
+    return c;
+}
+
+function variable(a: Polynomial, b: Polynomial): string | undefined | null {
+    if (a.x !== undefined && b.x !== undefined && a.x !== b.x)
+        return null;
+    return a.x !== undefined ? a.x : b.x;
+}
+
+function add(a: Polynomial, b: Polynomial, sign: number): Polynomial | undefined {
+    const x = variable(a, b);
+    if (x === null)
+        return undefined;
+    const c: number[] = [];
+    for (let i = 0; i < Math.max(a.c.length, b.c.length); i++)
+        c.push((a.c[i] || 0) + sign * (b.c[i] || 0));
+    return { x, c: trim(c) };
+}
+
+// A sum can only be scaled by a constant
+function multiply(a: Polynomial, b: Polynomial): Polynomial | undefined {
+    const x = variable(a, b);
+    if (x === null || a.c.length + b.c.length - 2 > maxDegree)
+        return undefined;
+    if (!isConstant(a) && !isConstant(b) && (!isMonomial(a) || !isMonomial(b)))
+        return undefined;
+    const c: number[] = [];
+    for (let i = 0; i < a.c.length + b.c.length - 1; i++)
+        c.push(0);
+    a.c.forEach((ai, i) => b.c.forEach((bj, j) => c[i + j] += ai * bj));
+    return { x, c: trim(c) };
+}
+
+function power(a: Polynomial, n: Polynomial): Polynomial | undefined {
+    if (!isMonomial(a) || !isConstant(n) || !Number.isInteger(n.c[0]) || n.c[0] < 0 || n.c[0] > maxDegree)
+        return undefined;
+    let r: Polynomial | undefined = { x: a.x, c: [1] };
+    for (let i = 0; i < n.c[0] && r; i++)
+        r = multiply(r, a);
+    return r;
+}
+
+// The polynomial computed by a side-effect free expression
+function polynomial(node: estree.Node): Polynomial | undefined {
+    switch (node.type) {
+        case 'Literal':
+            return typeof node.value === 'number' ? { c: [node.value] } : undefined;
+        case 'Identifier':
+            return { x: node.name, c: [0, 1] };
+        case 'MemberExpression': {
+            const k = globalConstant(node);
+            return k === undefined ? undefined : { c: [k] };
+        }
+        case 'UnaryExpression': {
+            const a = node.operator === '-' ? polynomial(node.argument) : undefined;
+            return a && { x: a.x, c: a.c.map((v) => -v) };
+        }
+        case 'BinaryExpression': {
+            const a = polynomial(node.left);
+            const b = a && polynomial(node.right);
+            if (!a || !b)
+                return undefined;
+            switch (node.operator) {
+                case '+': return add(a, b, 1);
+                case '-': return add(a, b, -1);
+                case '*': return multiply(a, b);
+                case '/': return isConstant(b) && b.c[0] !== 0 ? multiply(a, { c: [1 / b.c[0]] }) : undefined;
+                case '**': return power(a, b);
+            }
+            return undefined;
+        }
+        case 'CallExpression': {
+            if (!isMathCall(node, 'pow') || node.arguments.length !== 2)
+                return undefined;
+            const a = polynomial(node.arguments[0]);
+            const n = a && polynomial(node.arguments[1]);
+            return n && power(a as Polynomial, n);
+        }
+    }
+    return undefined;
+}
+
+// Arithmetic operations and calls in the original expression
+function cost(node: estree.Node): number {
+    switch (node.type) {
+        case 'UnaryExpression':
+            return 1 + cost(node.argument);
+        case 'BinaryExpression':
+            return 1 + cost(node.left) + cost(node.right);
+        case 'CallExpression':
+            return callCost + node.arguments.reduce((a, arg) => a + cost(arg as estree.Node), 0);
+    }
+    return 0;
+}
+
+// ((c[n]*x + c[n-1])*x + ...)*x + c[0] without the multiplications by 1 and the additions of 0
+function horner(p: Polynomial): { node: estree.Expression, ops: number } {
+    const x: estree.Identifier = { type: 'Identifier', name: p.x as string };
+    const n = p.c.length - 1;
+    let ops = 0;
+    let node: estree.Expression = x;
+    if (p.c[n] !== 1) {
+        node = binary('*', x, literal(p.c[n]));
+        ops++;
+    }
+    for (let i = n - 1; i >= 0; i--) {
+        if (p.c[i] !== 0) {
+            node = binary('+', node, literal(p.c[i]));
+            ops++;
+        }
+        if (i > 0) {
+            node = binary('*', node, x);
+            ops++;
+        }
+    }
+    return { node, ops };
+}
+
+function rewrite(node: estree.Node, rewrites?: Rewrites): estree.Node {
+    if (node.type === 'BinaryExpression' || node.type === 'UnaryExpression' || isMathCall(node, 'pow')) {
+        const p = polynomial(node);
+        if (p && p.x !== undefined && p.c.length > 2) {
+            const h = horner(p);
+            if (h.ops < cost(node)) {
+                countRewrite(rewrites, 'horner');
+                return h.node;
+            }
+        }
+    }
+
+    const children = node as unknown as Record<string, unknown>;
+    for (const key of Object.keys(children)) {
+        const child = children[key];
+        if (Array.isArray(child))
+            children[key] = child.map((c) => c && typeof c.type === 'string' ? rewrite(c, rewrites) : c);
+        else if (child && typeof child === 'object' && typeof (child as estree.Node).type === 'string')
+            children[key] = rewrite(child as estree.Node, rewrites);
+    }
+    return node;
+}
+
+export function rewritePolynomials<T extends estree.Node>(node: T, rewrites?: Rewrites): T {
+    return rewrite(node, rewrites) as T;
+}
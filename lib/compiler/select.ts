@@ -0,0 +1,92 @@
+import * as estree from 'estree';
+import { Unit } from '.';
+import { integerDivisor } from './division';
+import { isCounter } from './loop';
+import { callCost, isMathCall, globalConstant } from './ast';
+
+// Branchless select: a ternary computes both arms and picks one of them
+// with a conditional move, a mispredicted branch costs more than a few
+// arithmetic operations. Only the side-effect free expressions qualify,
+// and not an integer division unless the divisor is a constant: a div
+// instruction with the guards of its zero divisor costs more than a branch.
+
+// A multiplication by the magic number and the shifts
+const divisionCost = 4;
+
+// Above this cost of the arms that are not taken a branch is cheaper
+const maxSelectCost = 8;
+
+// The arithmetic operations and calls computed by an expression,
+// undefined when it cannot be computed unconditionally
+function cost(code: Unit, node: estree.Node): number | undefined {
+    const sum = (nodes: estree.Node[], base: number) => nodes.reduce<number | undefined>((a, n) => {
+        const c = a === undefined ? undefined : cost(code, n);
+        return c === undefined ? undefined : (a as number) + c;
+    }, base);
+    const integer = code.type !== 'Float64' && code.type !== 'Float32';
+
+    switch (node.type) {
+        case 'Literal':
+            return typeof node.value === 'number' ? 0 : undefined;
+        case 'Identifier':
+            return 0;
+        case 'MemberExpression':
+            return globalConstant(node) !== undefined ? 0 : undefined;
+        case 'UnaryExpression':
+            return ['-', '!', '~'].includes(node.operator) ? sum([node.argument], 1) : undefined;
+        case 'BinaryExpression':
+            if (integer && (node.operator === '/' || node.operator === '%'))
+                return integerDivisor(code, node.right) !== undefined ? sum([node.left], divisionCost) : undefined;
+            return sum([node.left, node.right], node.operator === '**' || node.operator === '%' ? callCost : 1);
+        case 'LogicalExpression':
+            return sum([node.left, node.right], 1);
+        case 'ConditionalExpression':
+            return sum([node.test, node.consequent, node.alternate], 1);
+        case 'CallExpression':
+            return isMathCall(node) ? sum(node.arguments as estree.Node[], callCost) : undefined;
+    }
+    return undefined;
+}
+
+// Evaluate the test and both arms without a branch, { branchless: true }
+// selects every side-effect free ternary and { branchless: false } none
+export function selectable(code: Unit, test: estree.Node, consequent: estree.Node, alternate: estree.Node): boolean {
+    if (code.branchless === false)
+        return false;
+    const arms = [test, consequent, alternate].map((n) => cost(code, n));
+    if (arms.some((c) => c === undefined))
+        return false;
+    return code.branchless === true || (arms[1] as number) + (arms[2] as number) <= maxSelectCost;
+}
+
+// if (c) x = a; else x = b; and if (c) x = a; as x = c ? a : b and x = c ? a : x
+export function selectAssignment(code: Unit, stmt: estree.IfStatement): estree.AssignmentExpression | undefined {
+    const assignment = (node: estree.Statement | null | undefined): estree.AssignmentExpression | undefined => {
+        if (node && node.type === 'BlockStatement' && node.body.length === 1)
+            node = node.body[0];
+        if (node && node.type === 'ExpressionStatement' && node.expression.type === 'AssignmentExpression' &&
+            node.expression.operator === '=' && node.expression.left.type === 'Identifier')
+            return node.expression;
+        return undefined;
+    };
+    const consequent = assignment(stmt.consequent);
+    if (!consequent)
+        return undefined;
+    const target = consequent.left as estree.Identifier;
+    // a counter is assigned only integer literals
+    if (isCounter(code, target.name))
+        return undefined;
+    const alternate = stmt.alternate ? assignment(stmt.alternate) : undefined;
+    if (stmt.alternate && (!alternate || (alternate.left as estree.Identifier).name !== target.name))
+        return undefined;
+
+    const select: estree.ConditionalExpression = {
+        type: 'ConditionalExpression',
+        test: stmt.test,
+        consequent: consequent.right,
+        alternate: alternate ? alternate.right : target
+    };
+    if (!selectable(code, select.test, select.consequent, select.alternate))
+        return undefined;
+    return { type: 'AssignmentExpression', operator: '=', left: target, right: select };
+}
@@ -0,0 +1,75 @@
+import { VectorInstruction } from './vector';
+
+// The precompiled kernels in src/shapes.h, x is the element
+// and every k is a constant bound at runtime in order of appearance
+export const shapes = [
+    'add(x,k)',
+    'sub(x,k)',
+    'sub(k,x)',
+    'mul(x,k)',
+    'div(x,k)',
+    'div(k,x)',
+    'add(mul(x,k),k)',
+    'sub(mul(x,k),k)',
+    'sub(k,mul(x,k))',
+    'mul(add(mul(x,k),k),k)',
+    'mul(x,x)',
+    'add(mul(x,x),k)',
+    'add(add(mul(x,k),mul(x,x)),k)',
+    'add(add(mul(mul(x,x),k),mul(x,k)),k)',
+    'add(add(mul(mul(x,k),x),mul(x,k)),k)',
+    'add(mul(add(x,k),x),k)',
+    'add(mul(add(mul(x,k),k),x),k)',
+    'add(mul(add(mul(add(x,k),x),k),x),k)',
+    'add(mul(add(mul(add(mul(x,k),k),x),k),x),k)',
+    'div(mul(x,x),k)',
+    'sub(k,div(mul(x,x),k))'
+];
+
+export interface Shape {
+    name: string;
+    constants: number[];
+}
+
+// Operands of + and * can be swapped without changing the IEEE 754 result
+const commutative: Record<string, boolean> = { add: true, mul: true };
+
+interface Node {
+    name: string;
+    constants: number[];
+    rank: number;
+}
+
+// Expressions first, then the element, then the constants
+function order(a: Node, b: Node): number {
+    if (a.rank !== b.rank)
+        return a.rank - b.rank;
+    return a.name < b.name ? -1 : a.name > b.name ? 1 : 0;
+}
+
+export function matchShape(
+    text: VectorInstruction[],
+    constants: { value: number, r: number }[],
+    result: number): Shape | undefined {
+
+    const tree = (r: number): Node | undefined => {
+        if (r === 0)
+            return { name: 'x', constants: [], rank: 1 };
+        const c = constants.find((c) => c.r === r);
+        if (c)
+            return { name: 'k', constants: [c.value], rank: 2 };
+        const op = text.find((op) => op.output === r);
+        if (!op || op.input.length !== 2)
+            return undefined;
+        const args = op.input.map(tree);
+        if (!args[0] || !args[1])
+            return undefined;
+        const [a, b] = commutative[op.op] && order(args[0], args[1]) > 0 ? [args[1], args[0]] : args as Node[];
+        return { name: `${op.op}(${a.name},${b.name})`, constants: [...a.constants, ...b.constants], rank: 0 };
+    };
+
+    const node = tree(result);
+    if (!node || shapes.indexOf(node.name) === -1)
+        return undefined;
+    return { name: node.name, constants: node.constants };
+}
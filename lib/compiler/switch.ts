@@ -0,0 +1,119 @@
+import * as estree from 'estree';
+import { Unit, processNode } from '.';
+import { getExprId } from './expression';
+import { Loop, integerLiteral, isCounter } from './loop';
+
+// A switch with enough integer literal cases close to each other jumps
+// through a table with the MIR switch, the others compare the discriminant
+// with each case in turn like an if / else chain. The table is indexed by
+// the value minus the smallest case, the values that are not integers or
+// out of the range go to the default.
+
+// Fewer cases are faster as comparisons
+const minTableCases = 4;
+
+// The table may have at most this many entries per case
+const maxTableSparsity = 3;
+
+// The cases that an integer of the function type can match
+function caseValue(code: Unit, test: estree.Node): number | undefined {
+    const v = integerLiteral(test);
+    if (v === undefined)
+        return undefined;
+    if (code.type === 'Int32' && (v < -(2 ** 31) || v >= 2 ** 31))
+        return undefined;
+    if (code.type === 'Uint32' && (v < 0 || v >= 2 ** 32))
+        return undefined;
+    return v;
+}
+
+// The labels of the table from the smallest case, undefined if a table does not pay off
+function jumpTable(code: Unit, cases: estree.SwitchCase[], labels: string[], otherwise: string):
+    { min: number, table: string[] } | undefined {
+    const tests = cases.filter((c) => c.test);
+    if (tests.length < minTableCases || tests.some((c) => integerLiteral(c.test as estree.Node) === undefined))
+        return undefined;
+    const values = cases.map((c) => c.test ? caseValue(code, c.test) : undefined);
+    const valid = values.filter((v) => v !== undefined) as number[];
+    if (!valid.length)
+        return undefined;
+    const min = Math.min(...valid);
+    const size = Math.max(...valid) - min + 1;
+    if (size > maxTableSparsity * tests.length)
+        return undefined;
+    const table: (string | undefined)[] = new Array(size).fill(undefined);
+    // the first of the duplicate cases matches
+    values.forEach((v, i) => {
+        if (v !== undefined && table[v - min] === undefined)
+            table[v - min] = labels[i];
+    });
+    return { min, table: table.map((l) => l === undefined ? otherwise : l as string) };
+}
+
+// The discriminant in an i64, the values that are not integers jump to otherwise
+function integerValue(code: Unit, prefix: string, value: string, otherwise: string): string {
+    const integer = `${prefix}_integer`;
+    code.variables[integer] = 'offset';
+    if (code.type === 'Int32' || code.type === 'Uint32') {
+        code.text.push({ op: code.type === 'Int32' ? 'ext32' : 'uext32', output: integer, input: [value] });
+        return integer;
+    }
+    // the integers convert back to the same value, NaN and the fractions do not
+    const back = `${prefix}_back`;
+    code.variables[back] = 'value';
+    const float = code.type === 'Float32';
+    code.text.push({ op: float ? 'f2i' : 'd2i', raw: true, output: integer, input: [value] });
+    code.text.push({ op: float ? 'i2f' : 'i2d', raw: true, output: back, input: [integer] });
+    code.text.push({ op: 'bne', output: otherwise, input: [back, value] });
+    return integer;
+}
+
+export function processSwitch(code: Unit, node: estree.SwitchStatement, name?: string): void {
+    const id = getExprId(code);
+    const end = `_switch_${id}_end`;
+    const labels = node.cases.map((c, i) => `_switch_${id}_case_${i}`);
+    const defaultCase = node.cases.findIndex((c) => !c.test);
+    const otherwise = defaultCase >= 0 ? labels[defaultCase] : end;
+
+    const jump = jumpTable(code, node.cases, labels, otherwise);
+    const counter = jump && node.discriminant.type === 'Identifier' && isCounter(code, node.discriminant.name) ?
+        node.discriminant.name : undefined;
+    const discriminant = counter ? { ref: counter } : processNode(code, node.discriminant);
+    if (!discriminant) throw new SyntaxError('invalid switch discriminant ' + node.discriminant);
+    const value = discriminant.ref;
+
+    if (jump) {
+        // a counter is already an integer
+        const integer = counter || integerValue(code, `_switch_${id}`, value, otherwise);
+        // below the smallest case the index wraps around to a large unsigned value
+        const index = jump.min === 0 ? integer : `_switch_${id}_index`;
+        if (index !== integer) {
+            code.variables[index] = 'offset';
+            code.text.push({ op: 'sub', raw: true, output: index, input: [integer, jump.min.toString()] });
+        }
+        const last = (jump.table.length - 1).toString();
+        code.text.push({ op: 'ubgt', raw: true, output: otherwise, input: [index, last] });
+        code.text.push({ op: 'switch', raw: true, input: [index, ...jump.table] });
+    } else {
+        node.cases.forEach((c, i) => {
+            if (!c.test)
+                return;
+            const test = processNode(code, c.test);
+            if (!test) throw new SyntaxError('invalid switch case ' + c.test);
+            code.text.push({ op: 'beq', output: labels[i], input: [value, test.ref] });
+        });
+        code.text.push({ op: 'jmp', raw: true, output: otherwise });
+    }
+
+    const loop: Loop = { name, break: end };
+    if (!code.loops)
+        code.loops = [];
+    code.loops.push(loop);
+    node.cases.forEach((c, i) => {
+        code.text.push({ op: 'label', output: labels[i] });
+        for (const stmt of c.consequent)
+            processNode(code, stmt);
+    });
+    code.loops.pop();
+    code.text.push({ op: 'label', output: end });
+}
@@ -0,0 +1,126 @@
+import * as estree from 'estree';
+import { Unit, Value, processNode } from '.';
+import { getExprId } from './expression';
+import { constantExponent } from './function';
+import { addConstant, processGlobalConstant } from './variable';
+import { isCounter } from './loop';
+
+// Constant arrays of numbers are MIR data items and c[k] is an indexed
+// load. JavaScript reads undefined outside of the array: the index is
+// clamped without a branch to an extra element after the table that holds
+// NaN for the floating point types and 0 for the integers, like the
+// undefined | 0 of the integer expressions. A floating point index that
+// is not an integer reads the extra element too.
+
+export interface Table {
+    // the name of the data item
+    data: string;
+    // the local holding its address
+    base: string;
+    values: number[];
+}
+
+// The bits of the quiet NaN, MIR has no literal for it
+const nanBits: Record<string, string> = {
+    'Float64': 'u64\t9221120237041090560',
+    'Float32': 'u32\t2143289344'
+};
+
+export function processTableDeclaration(code: Unit, name: string, init: estree.ArrayExpression): void {
+    if (code.writes && code.writes[name] > 1)
+        throw new TypeError(`The constant array ${name} cannot be assigned`);
+    // a MIR data item needs at least one value on its labeled line
+    if (!init.elements.length)
+        throw new SyntaxError(`The constant array ${name} cannot be empty`);
+    const values = init.elements.map((e) => {
+        const v = e && e.type !== 'SpreadElement' ? constantExponent(e) : undefined;
+        if (v === undefined)
+            throw new SyntaxError(`The elements of the array ${name} must be number literals`);
+        if ((code.type === 'Int32' && (v !== (v | 0))) || (code.type === 'Uint32' && v !== (v >>> 0)))
+            throw new TypeError(`The elements of the array ${name} must be ${code.type} numbers`);
+        return v;
+    });
+    if (!code.tables)
+        code.tables = {};
+    const table: Table = { data: `_table_${code.name}_${name}`, base: `_table_${name}`, values };
+    code.tables[name] = table;
+    code.variables[table.base] = 'offset';
+}
+
+export function isTable(code: Unit, name: string): boolean {
+    return !!code.tables && !!code.tables[name];
+}
+
+// The data items of the module, each followed by the element read out of bounds
+export function tableData(code: Unit, type: string, format: (v: number) => string): string {
+    let mir = '';
+    for (const table of Object.values(code.tables || {})) {
+        const fallback = nanBits[code.type];
+        mir += `${table.data}:\t${type}\t${table.values.map(format).concat(fallback ? [] : ['0']).join(', ')}\n`;
+        if (fallback)
+            mir += `\t${fallback}\n`;
+    }
+    return mir;
+}
+
+// c[k] and c.length of a table, the other member expressions are global constants
+export function processMemberExpression(code: Unit, node: estree.MemberExpression): Value {
+    if (node.object.type !== 'Identifier' || !isTable(code, node.object.name))
+        return processGlobalConstant(code, node);
+    const table = (code.tables as Record<string, Table>)[node.object.name];
+    const length = table.values.length;
+    if (!node.computed) {
+        if (node.property.type === 'Identifier' && node.property.name === 'length')
+            return addConstant(code, length);
+        throw new SyntaxError(`Unsupported property of the array ${node.object.name}`);
+    }
+
+    const k = constantExponent(node.property);
+    if (k !== undefined && Number.isInteger(k) && k >= 0 && k < length)
+        return addConstant(code, table.values[k]);
+
+    const id = getExprId(code);
+    const prefix = `_expr_${id}`;
+    const temp = (name: string) => {
+        code.variables[`${prefix}_${name}`] = 'offset';
+        return `${prefix}_${name}`;
+    };
+    const raw = (op: 'd2i' | 'f2i' | 'i2d' | 'i2f' | 'ext32' | 'uext32' | 'eq' | 'ult' | 'and' | 'sel',
+        output: string, input: string[]) => code.text.push({ op, raw: true, output, input });
+
+    let index: string;
+    let integral: string | undefined;
+    if (node.property.type === 'Identifier' && isCounter(code, node.property.name)) {
+        index = node.property.name;
+    } else {
+        const key = processNode(code, node.property as estree.Expression);
+        if (!key) throw new SyntaxError('invalid array index ' + node.property);
+        index = temp('index');
+        if (code.type === 'Float64' || code.type === 'Float32') {
+            // the integers convert back to the same value, NaN and the fractions do not
+            const back = `${prefix}_back`;
+            code.variables[back] = 'value';
+            const float = code.type === 'Float32';
+            raw(float ? 'f2i' : 'd2i', index, [key.ref]);
+            raw(float ? 'i2f' : 'i2d', back, [index]);
+            integral = temp('integral');
+            code.text.push({ op: 'eq', output: integral, input: [back, key.ref] });
+        } else {
+            raw(code.type === 'Int32' ? 'ext32' : 'uext32', index, [key.ref]);
+        }
+    }
+    // a negative index is a large unsigned one
+    let inside = temp('inside');
+    raw('ult', inside, [index, length.toString()]);
+    if (integral) {
+        const valid = temp('valid');
+        raw('and', valid, [inside, integral]);
+        inside = valid;
+    }
+    const clamped = temp('clamped');
+    raw('sel', clamped, [inside, index, length.toString()]);
+
+    code.variables[prefix] = 'value';
+    code.text.push({ op: 'load', output: prefix, input: [table.base, clamped] });
+    return { ref: prefix };
+}
@@ -1,5 +1,7 @@
 import * as estree from 'estree';
 import { Unit, Value, processNode } from '.';
+import { isCounter, integerLiteral } from './loop';
+import { processTableDeclaration } from './table';
 
 export function getInitEnd(code: Unit): number {
     let initEnd = code.text.findIndex((op) => op.op === 'label' && op.output === '_func_start');
@@ -14,38 +16,68 @@ export function getInitEnd(code: Unit): number {
     return initEnd;
 }
 
-function formatConstant(code: Unit, value: number): string {
+// Enough significant digits to read back the same value, toFixed()
+// would lose the small coefficients
+export function formatConstant(code: Unit, value: number): string {
     if (code.type === 'Float64')
-        return value.toFixed(16);
+        return value.toPrecision(17);
     if (code.type === 'Float32')
-        return value.toFixed(8) + 'f';
+        return value.toPrecision(9) + 'f';
     return value.toString();
 }
 
+// The constants and the addresses of the tables are loaded once before _func_start by emitConstants()
 export function addConstant(code: Unit, value: number): Value {
-    const existing = Object.keys(code.constants).find((c) => code.constants[c] === value);
+    if (!code.constantRefs)
+        code.constantRefs = new Map();
+    const existing = code.constantRefs.get(value);
     if (existing !== undefined)
         return { ref: existing };
 
-    getInitEnd(code);
-
     if (!code.tempId)
         code.tempId = 0;
     const name = `_constant_${code.tempId++}`;
 
     code.constants[name] = value;
-    code.text.unshift({
-        op: 'mov',
-        output: name,
-        input: [formatConstant(code, value)]
-    });
-
+    code.constantRefs.set(value, name);
     return { ref: name };
 }
 
+// Called once at the end of processFunction(),
+// inserting them one by one at the start of the text would be quadratic
+export function emitConstants(code: Unit): void {
+    const names = Object.keys(code.constants);
+    const tables = Object.values(code.tables || {});
+    if (!names.length && !tables.length)
+        return;
+    getInitEnd(code);
+    code.text.unshift(...names.reverse().map((name) => ({
+        op: 'mov' as const,
+        output: name,
+        input: [formatConstant(code, code.constants[name])]
+    })), ...tables.map((table) => ({
+        op: 'mov' as const,
+        raw: true,
+        output: table.base,
+        input: [table.data]
+    })));
+}
+
 export function processVariableDeclaration(code: Unit, v: estree.VariableDeclarator): void {
     if (v.id.type != 'Identifier') throw new SyntaxError('Unsupported variable declarator ' + v.id.type);
     const name = v.id.name;
+    if (isCounter(code, name)) {
+        code.variables[name] = 'offset';
+        code.text.push({
+            op: 'mov',
+            raw: true,
+            output: name,
+            input: [(integerLiteral(v.init as estree.Node) as number).toString()]
+        });
+        return;
+    }
+    if (v.init && v.init.type === 'ArrayExpression')
+        return processTableDeclaration(code, name, v.init);
     code.variables[name] = 'value';
     let init;
     if (v.init)
@@ -66,7 +98,7 @@ export function processConstant(code: Unit, v: estree.Literal): Value {
     return addConstant(code, v.value);
 }
 
-export function processGlobalConstant(code: Unit, v: estree.MemberExpression | estree.Identifier): Value {
+export function getGlobalConstant(v: estree.MemberExpression | estree.Identifier): number {
     let obj: Record<string, unknown> | undefined;
     let name = '';
 
@@ -87,5 +119,9 @@ export function processGlobalConstant(code: Unit, v: estree.MemberExpression | e
     if (val === undefined || typeof val !== 'number')
         throw new TypeError(`${name} is not a number`);
 
-    return addConstant(code, val);
+    return val;
+}
+
+export function processGlobalConstant(code: Unit, v: estree.MemberExpression | estree.Identifier): Value {
+    return addConstant(code, getGlobalConstant(v));
 }
\ No newline at end of file
@@ -0,0 +1,288 @@
+import * as estree from 'estree';
+import { VarType, Precision, CompileOptions } from '.';
+import { getGlobalConstant } from './variable';
+import { matchShape, Shape } from './shapes';
+import { getBuiltin, vectorBuiltins, powCall, constantExponent, powChainExponent, maxFinite } from './function';
+
+export type VectorOp = 'mov' | 'add' | 'sub' | 'mul' | 'div' | 'neg' | 'not' |
+    'eq' | 'ne' | 'lt' | 'le' | 'gt' | 'ge' | 'select' | 'fma' | 'call';
+
+export interface VectorInstruction {
+    op: VectorOp;
+    output: number;
+    input: number[];
+    // the Math builtin, called once per block
+    fn?: string;
+}
+
+// A straight-line program over blocks of elements, register 0
+// is the input block and the constants are preloaded registers
+export interface VectorProgram {
+    registers: number;
+    constants: { register: number, value: number }[];
+    text: VectorInstruction[];
+    result: number;
+    // a precompiled kernel computing the same expression
+    shape?: Shape;
+}
+
+const binaryOps: Record<string, VectorOp> = {
+    '+': 'add',
+    '-': 'sub',
+    '*': 'mul',
+    '/': 'div',
+    '>': 'gt',
+    '<': 'lt',
+    '==': 'eq',
+    '!=': 'ne',
+    '>=': 'ge',
+    '<=': 'le'
+};
+
+// Thrown when the function cannot be vectorized, map() falls back to MIR
+const notVectorizable = new Error('Not vectorizable');
+
+interface Builder {
+    iter: string;
+    type: VarType;
+    precision?: Precision;
+    fma?: boolean;
+    fastMath?: boolean;
+    variables: Record<string, number>;
+    constants: { value: number, r: number }[];
+    text: VectorInstruction[];
+    next: number;
+    // the registers are assigned once, an instruction that was
+    // already emitted with the same inputs returns its output
+    emitted: Map<string, number>;
+}
+
+function emit(b: Builder, op: VectorOp, input: number[], fn?: string): number {
+    const key = `${fn || op}(${input.join(',')})`;
+    const existing = b.emitted.get(key);
+    if (existing !== undefined)
+        return existing;
+    const output = b.next++;
+    b.text.push(fn ? { op, output, input, fn } : { op, output, input });
+    b.emitted.set(key, output);
+    return output;
+}
+
+function constant(b: Builder, value: number): number {
+    // Object.is() keeps 0 and -0 apart
+    const existing = b.constants.find((c) => Object.is(c.value, value));
+    if (existing)
+        return existing.r;
+    b.constants.push({ value, r: b.next });
+    return b.next++;
+}
+
+// The same lowering of Math.pow() with a constant exponent as in the MIR code
+function constantPow(b: Builder, base: number, n: number): number | undefined {
+    if (n === 0.5 || (n === -0.5 && b.fastMath)) {
+        let root;
+        if (b.fastMath) {
+            root = emit(b, 'call', [base], 'sqrt');
+        } else {
+            // Math.pow(-0, 0.5) is 0 and Math.pow(-Infinity, 0.5) is Infinity
+            const infinite = emit(b, 'lt', [base, constant(b, -maxFinite(b.type))]);
+            const sqrt = emit(b, 'call', [emit(b, 'add', [base, constant(b, 0)])], 'sqrt');
+            root = emit(b, 'select', [infinite, emit(b, 'neg', [base]), sqrt]);
+        }
+        return n > 0 ? root : emit(b, 'div', [constant(b, 1), root]);
+    }
+    if (!powChainExponent(n, b.fastMath))
+        return undefined;
+
+    if (n === 0)
+        return constant(b, 1);
+    const bits = Math.abs(n).toString(2);
+    let power = base;
+    for (let i = 1; i < bits.length; i++) {
+        power = emit(b, 'mul', [power, power]);
+        if (bits[i] === '1')
+            power = emit(b, 'mul', [power, base]);
+    }
+    return n > 0 ? power : emit(b, 'div', [constant(b, 1), power]);
+}
+
+function expression(b: Builder, node: estree.Node): number {
+    switch (node.type) {
+        case 'Identifier':
+            if (node.name === b.iter)
+                return 0;
+            if (b.variables[node.name] !== undefined)
+                return b.variables[node.name];
+            throw notVectorizable;
+        case 'Literal':
+            if (typeof node.value !== 'number')
+                throw notVectorizable;
+            return constant(b, node.value);
+        case 'MemberExpression':
+            return constant(b, getGlobalConstant(node));
+        case 'BinaryExpression':
+            if (node.operator === '**')
+                return expression(b, powCall(node.left, node.right));
+            if (!binaryOps[node.operator])
+                throw notVectorizable;
+            if (b.fma && (node.operator === '+' || node.operator === '-')) {
+                // evaluated in source order like the MIR multiply-add
+                if (node.left.type === 'BinaryExpression' && node.left.operator === '*') {
+                    const x = expression(b, node.left.left);
+                    const y = expression(b, node.left.right);
+                    const z = expression(b, node.right);
+                    return emit(b, 'fma', [x, y, node.operator === '-' ? emit(b, 'neg', [z]) : z]);
+                }
+                if (node.right.type === 'BinaryExpression' && node.right.operator === '*') {
+                    const z = expression(b, node.left);
+                    const x = expression(b, node.right.left);
+                    const y = expression(b, node.right.right);
+                    return emit(b, 'fma', [node.operator === '-' ? emit(b, 'neg', [x]) : x, y, z]);
+                }
+            }
+            return emit(b, binaryOps[node.operator], [expression(b, node.left), expression(b, node.right)]);
+        case 'UnaryExpression':
+            if (node.operator === '-')
+                return emit(b, 'neg', [expression(b, node.argument)]);
+            if (node.operator === '!')
+                return emit(b, 'not', [expression(b, node.argument)]);
+            throw notVectorizable;
+        case 'LogicalExpression': {
+            // both sides are evaluated, the blend picks the JavaScript result
+            const left = expression(b, node.left);
+            const right = expression(b, node.right);
+            if (node.operator === '&&')
+                return emit(b, 'select', [left, right, left]);
+            if (node.operator === '||')
+                return emit(b, 'select', [left, left, right]);
+            throw notVectorizable;
+        }
+        case 'CallExpression': {
+            if (node.callee.type !== 'MemberExpression' || node.callee.object.type !== 'Identifier' ||
+                node.callee.property.type !== 'Identifier')
+                throw notVectorizable;
+            const fn = getBuiltin(`${node.callee.object.name}.${node.callee.property.name}`, b.precision);
+            if (!fn || node.arguments.length !== fn.arg)
+                throw notVectorizable;
+            const c = b.precision === 'vector' && vectorBuiltins[fn.c] ? vectorBuiltins[fn.c] : fn.c;
+            const exponent = fn.c === 'pow' ? constantExponent(node.arguments[1] as estree.Node) : undefined;
+            if (exponent !== undefined) {
+                const base = expression(b, node.arguments[0]);
+                const power = constantPow(b, base, exponent);
+                return power !== undefined ? power : emit(b, 'call', [base, constant(b, exponent)], c);
+            }
+            return emit(b, 'call', node.arguments.map((arg) => expression(b, arg)), c);
+        }
+        case 'ConditionalExpression':
+            return emit(b, 'select', [
+                expression(b, node.test),
+                expression(b, node.consequent),
+                expression(b, node.alternate)
+            ]);
+        default:
+            throw notVectorizable;
+    }
+}
+
+function body(b: Builder, node: estree.Node): number {
+    if (node.type !== 'BlockStatement')
+        return expression(b, node);
+
+    // only a sequence of declarations followed by a return
+    for (let i = 0; i < node.body.length; i++) {
+        const stmt = node.body[i];
+        if (stmt.type === 'ReturnStatement' && i === node.body.length - 1 && stmt.argument)
+            return expression(b, stmt.argument);
+        if (stmt.type !== 'VariableDeclaration')
+            throw notVectorizable;
+        for (const v of stmt.declarations) {
+            if (v.id.type !== 'Identifier' || !v.init || b.variables[v.id.name] !== undefined || v.id.name === b.iter)
+                throw notVectorizable;
+            b.variables[v.id.name] = expression(b, v.init);
+        }
+    }
+    throw notVectorizable;
+}
+
+// Map the SSA registers to as few block buffers as possible,
+// an output never shares its buffer with one of its inputs
+function allocate(b: Builder, result: number): VectorProgram {
+    const live: Record<number, boolean> = { [result]: true };
+    const text: VectorInstruction[] = [];
+    for (let i = b.text.length - 1; i >= 0; i--) {
+        if (live[b.text[i].output]) {
+            text.unshift(b.text[i]);
+            b.text[i].input.forEach((r) => live[r] = true);
+        }
+    }
+
+    const lastUse: Record<number, number> = {};
+    text.forEach((op, i) => op.input.forEach((r) => lastUse[r] = i));
+
+    const constants = b.constants
+        .filter((c) => live[c.r])
+        .map((c, i) => ({ ...c, register: i + 1 }));
+    const map: Record<number, number> = { 0: 0 };
+    constants.forEach((c) => map[c.r] = c.register);
+
+    let registers = constants.length + 1;
+    const free: number[] = [];
+    const program: VectorInstruction[] = [];
+    text.forEach((op, i) => {
+        const output = free.length ? free.pop() as number : registers++;
+        program.push({ ...op, output, input: op.input.map((r) => map[r]) });
+        map[op.output] = output;
+        op.input.forEach((r, j) => {
+            if (lastUse[r] === i && op.input.indexOf(r) === j && map[r] > constants.length && r !== result)
+                free.push(map[r]);
+        });
+    });
+
+    return {
+        registers,
+        constants: constants.map((c) => ({ register: c.register, value: c.value })),
+        text: program,
+        result: map[result]
+    };
+}
+
+export function generateVector(
+    node: estree.FunctionExpression | estree.ArrowFunctionExpression,
+    type: VarType,
+    iter: string,
+    options?: CompileOptions): VectorProgram | undefined {
+
+    if (type !== 'Float64' && type !== 'Float32')
+        return undefined;
+    if (!node.params.some((p) => p.type === 'Identifier' && p.name === iter))
+        return undefined;
+
+    const b: Builder = {
+        iter,
+        type,
+        precision: options && options.precision,
+        fma: options && options.fma,
+        fastMath: options && options.fastMath,
+        variables: {},
+        constants: [],
+        text: [],
+        next: 1,
+        emitted: new Map()
+    };
+    let result;
+    try {
+        result = body(b, node.body);
+    } catch (e) {
+        if (e === notVectorizable)
+            return undefined;
+        throw e;
+    }
+
+    // the result must be a computed block
+    if (!b.text.some((op) => op.output === result))
+        result = emit(b, 'mov', [result]);
+
+    const program = allocate(b, result);
+    program.shape = matchShape(b.text, b.constants, result);
+    return program;
+}
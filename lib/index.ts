@@ -1,6 +1,7 @@
-import { JeetahFn, compileBody, compile, compileMap, genModule } from './compiler';
+import { JeetahFn, CompileOptions, compileBody, compile, compileMap, genModule } from './compiler';
+import { installAdaptive } from './adaptive';
 
-export { JeetahFn, compileBody, compile, compileMap, genModule };
+export { JeetahFn, CompileOptions, compileBody, compile, compileMap, genModule };
 export type VarType = 'Float64' | 'Float32';
 
 export type TypedArray = Int8Array | Uint8Array | Int16Array | Uint16Array | Int32Array | Uint32Array |
@@ -19,25 +20,59 @@ const native = require(binding_path);
 
 // https://stackoverflow.com/questions/44275172/typescript-declarations-file-for-node-c-addon
 export interface JeetahExpression {
+    readonly fn: JeetahFn;
     eval(...args: number[]): number;
-    map(array: TypedArray, iter: string): TypedArray;
+    map(array: TypedArray, iter: string, result?: TypedArray): TypedArray;
+    mapMany(arrays: TypedArray[], iter: string, results?: TypedArray[]): TypedArray[];
+    mapFixed(array: TypedArray, iter: string, result?: TypedArray): TypedArray;
+    bind(array: TypedArray, iter: string, result: TypedArray): JeetahKernel;
+    dispose(): void;
 }
 
+// Runs the expression in V8 on arrays that are too small to benefit from the JIT,
+// the break-even size is measured on the first call
+export interface JeetahFloat64Expression extends JeetahExpression {
+    adaptiveMap(array: TypedArray, iter: string, result?: TypedArray): TypedArray;
+}
+
+export interface JeetahKernel {
+    run(): void;
+}
+
+installAdaptive(native.Float64Expression);
+
 export const Float64Expression: {
-    new(fn: JeetahFn): JeetahExpression
+    new(fn: JeetahFn, options?: CompileOptions): JeetahFloat64Expression
 } = native.Float64Expression;
 
 export const Float32Expression: {
-    new(fn: JeetahFn): JeetahExpression
+    new(fn: JeetahFn, options?: CompileOptions): JeetahExpression
 } = native.Float32Expression;
 
 export const Uint32Expression: {
-    new(fn: JeetahFn): JeetahExpression
+    new(fn: JeetahFn, options?: CompileOptions): JeetahExpression
 } = native.Uint32Expression;
 
 export const Int32Expression: {
-    new(fn: JeetahFn): JeetahExpression
+    new(fn: JeetahFn, options?: CompileOptions): JeetahExpression
 } = native.Int32Expression;
 
+// The instruction set extensions detected when the addon was loaded
+// and the build of the vector kernels selected for them
+export interface CpuFeatures {
+    sse2: boolean;
+    sse41: boolean;
+    avx: boolean;
+    avx2: boolean;
+    fma: boolean;
+    avx512f: boolean;
+    avx512dq: boolean;
+    kernels: 'generic' | 'avx2' | 'avx512';
+    // { precision: 'vector' } calls the vector variants of glibc
+    libmvec: boolean;
+}
+
+export const cpuFeatures: CpuFeatures = native.cpuFeatures;
+
 export type JeetahConstructor = typeof Float32Expression | typeof Float64Expression |
     typeof Uint32Expression | typeof Int32Expression;
@@ -0,0 +1,30 @@
+#pragma once
+
+#include "libm.h"
+
+namespace jeetah {
+
+// Math.round() rounds the half-way cases towards +Infinity
+// while std::round() rounds them away from zero
+template <typename T> static inline T JSRound(T v) {
+  T r = libm::floor(v);
+  if (v - r >= T(0.5)) r += T(1);
+  return r == T(0) ? libm::copysign(T(0), v) : r;
+}
+
+// Math.min() and Math.max() propagate NaN and order -0 below +0
+template <typename T> static inline T JSMin(T a, T b) {
+  if (a < b) return a;
+  if (b < a) return b;
+  if (a != b) return a + b;
+  return libm::signbit(a) ? a : b;
+}
+
+template <typename T> static inline T JSMax(T a, T b) {
+  if (a > b) return a;
+  if (b > a) return b;
+  if (a != b) return a + b;
+  return libm::signbit(a) ? b : a;
+}
+
+}; // namespace jeetah
@@ -0,0 +1,109 @@
+#include "cpu.h"
+#include "kernels.h"
+#include <cstdint>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <immintrin.h>
+#include <intrin.h>
+#define JEETAH_CPUID
+#elif defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#define JEETAH_CPUID
+#endif
+
+namespace jeetah {
+
+#ifdef JEETAH_CPUID
+static void CpuId(uint32_t leaf, uint32_t subleaf, uint32_t regs[4]) {
+#ifdef _MSC_VER
+  int r[4];
+  __cpuidex(r, static_cast<int>(leaf), static_cast<int>(subleaf));
+  for (int i = 0; i < 4; i++) regs[i] = static_cast<uint32_t>(r[i]);
+#else
+  __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+// The register state enabled by the OS in XCR0
+static uint64_t XGetBv() {
+#ifdef _MSC_VER
+  return _xgetbv(0);
+#else
+  uint32_t lo, hi;
+  __asm__ __volatile__("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+  return (static_cast<uint64_t>(hi) << 32) | lo;
+#endif
+}
+#endif
+
+static CpuFeatures Detect() {
+  CpuFeatures features = {false, false, false, false, false, false, false};
+#ifdef JEETAH_CPUID
+  uint32_t r[4];
+  CpuId(0, 0, r);
+  const uint32_t maxLeaf = r[0];
+  if (maxLeaf < 1) return features;
+
+  CpuId(1, 0, r);
+  features.sse2 = (r[3] >> 26) & 1;
+  features.sse41 = (r[2] >> 19) & 1;
+  const bool osxsave = (r[2] >> 27) & 1;
+  const uint64_t xcr0 = osxsave ? XGetBv() : 0;
+  // XMM and YMM, then also the opmask and the upper ZMM registers
+  const bool ymm = (xcr0 & 0x06) == 0x06;
+  const bool zmm = (xcr0 & 0xe6) == 0xe6;
+  features.avx = ymm && ((r[2] >> 28) & 1);
+  features.fma = features.avx && ((r[2] >> 12) & 1);
+
+  if (maxLeaf >= 7) {
+    CpuId(7, 0, r);
+    features.avx2 = features.avx && ((r[1] >> 5) & 1);
+    features.avx512f = zmm && ((r[1] >> 16) & 1);
+    features.avx512dq = zmm && ((r[1] >> 17) & 1);
+  }
+#endif
+  return features;
+}
+
+const CpuFeatures &DetectCpu() {
+  static const CpuFeatures features = Detect();
+  return features;
+}
+
+enum KernelSet { Generic, Avx2, Avx512 };
+
+static KernelSet BestKernels() {
+#ifdef JEETAH_X64
+  const CpuFeatures &cpu = DetectCpu();
+  if (cpu.avx512f && cpu.avx512dq && cpu.avx2 && cpu.fma) return Avx512;
+  if (cpu.avx2 && cpu.fma) return Avx2;
+#endif
+  return Generic;
+}
+
+const char *KernelsName() {
+  static const char *names[] = {"generic", "avx2", "avx512"};
+  return names[BestKernels()];
+}
+
+template <typename T> static Kernels<T> Select() {
+  switch (BestKernels()) {
+#ifdef JEETAH_X64
+    case Avx512: return avx512::GetKernels<T>();
+    case Avx2: return avx2::GetKernels<T>();
+#endif
+    default: return generic::GetKernels<T>();
+  }
+}
+
+template <typename T> const Kernels<T> &SelectKernels() {
+  static const Kernels<T> kernels = Select<T>();
+  return kernels;
+}
+
+template const Kernels<double> &SelectKernels<double>();
+template const Kernels<float> &SelectKernels<float>();
+template const Kernels<uint32_t> &SelectKernels<uint32_t>();
+template const Kernels<int32_t> &SelectKernels<int32_t>();
+
+}; // namespace jeetah
@@ -0,0 +1,17 @@
+#pragma once
+
+namespace jeetah {
+
+// The instruction set extensions usable by the addon,
+// the AVX ones also require the OS to save the registers
+struct CpuFeatures {
+  bool sse2, sse41, avx, avx2, fma, avx512f, avx512dq;
+};
+
+// Detected on the first call, Init() makes sure it happens at load time
+const CpuFeatures &DetectCpu();
+
+// The instruction set of the vector kernels chosen by SelectKernels()
+const char *KernelsName();
+
+}; // namespace jeetah
@@ -0,0 +1,229 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <math.h>
+
+namespace jeetah {
+
+// Polynomial approximations used by the { precision: 'fast' } expressions.
+// There are no branches and no calls so that the block loops of the vector
+// programs become packed SIMD, the special values are patched by selects.
+//
+// Maximum error measured against the correctly rounded result:
+//
+//          double                          float
+//   sin    2.5 ULP for |x| < 1e5           2 ULP for |x| < 1e5
+//   cos    2.5 ULP for |x| < 1e5           2 ULP for |x| < 1e5
+//   exp    1 ULP, 0 below 2^-1021          1 ULP, 0 below 2^-124
+//   log    1 ULP                           1 ULP
+//
+// sin() and cos() lose accuracy outside of this range and
+// exp() flushes the results that would be subnormal to zero
+namespace fast {
+
+static inline uint64_t Bits(double v) {
+  uint64_t u;
+  std::memcpy(&u, &v, sizeof(u));
+  return u;
+}
+
+static inline double Double(uint64_t u) {
+  double v;
+  std::memcpy(&v, &u, sizeof(v));
+  return v;
+}
+
+static inline uint32_t Bits(float v) {
+  uint32_t u;
+  std::memcpy(&u, &v, sizeof(u));
+  return u;
+}
+
+static inline float Float(uint32_t u) {
+  float v;
+  std::memcpy(&v, &u, sizeof(v));
+  return v;
+}
+
+// Adding 1.5 * 2^(mantissa bits) rounds to an integer that
+// can be read from the low bits of the mantissa
+static const double roundDouble = 6755399441055744.0;
+static const float roundFloat = 12582912.0f;
+
+// Sine and cosine of x reduced to [-pi/4, pi/4] with the quadrant in q
+template <typename T, typename U> struct Quadrant {
+  T sin, cos;
+  U q;
+};
+
+static inline Quadrant<double, uint64_t> SinCos(double x) {
+  const double kd = x * 0.63661977236758134308 + roundDouble;
+  const double k = kd - roundDouble;
+  // pi/2 in three parts, the first two have 33 bits and k * part is exact
+  const double r = ((x - k * 1.57079632673412561417e+00) - k * 6.07710050630396597660e-11) - k * 2.02226624879595063154e-21;
+  const double z = r * r;
+
+  Quadrant<double, uint64_t> result;
+  result.sin = r + r * z *
+      (-1.66666666666666324348e-01 +
+       z * (8.33333333332248946124e-03 +
+            z * (-1.98412698298579493134e-04 +
+                 z * (2.75573137070700676789e-06 + z * (-2.50507602534068634195e-08 + z * 1.58969099521155010221e-10)))));
+  result.cos = 1.0 - 0.5 * z +
+    z * z *
+      (4.16666666666666019037e-02 +
+       z * (-1.38888888888741095749e-03 +
+            z * (2.48015872894767294178e-05 +
+                 z * (-2.75573143513906633035e-07 + z * (2.08757232129817482790e-09 + z * -1.13596475577881948265e-11)))));
+  result.q = Bits(kd);
+  return result;
+}
+
+// The reduction is done in double precision, float has too few bits for pi/2
+static inline Quadrant<float, uint32_t> SinCos(float x) {
+  const double kd = x * 0.63661977236758134308 + roundDouble;
+  const double k = kd - roundDouble;
+  const float r = static_cast<float>((x - k * 1.57079632673412561417e+00) - k * 6.07710050650619224932e-11);
+  const float z = r * r;
+
+  Quadrant<float, uint32_t> result;
+  result.sin = r + r * z * (-1.6666654611e-1f + z * (8.3321608736e-3f + z * -1.9515295891e-4f));
+  result.cos = 1.0f - 0.5f * z + z * z * (4.166664568298827e-2f + z * (-1.388731625493765e-3f + z * 2.443315711809948e-5f));
+  result.q = static_cast<uint32_t>(Bits(kd));
+  return result;
+}
+
+// Quadrant 0 is sin(r), 1 is cos(r), 2 is -sin(r) and 3 is -cos(r)
+static inline double Rotate(const Quadrant<double, uint64_t> &v, uint64_t q) {
+  const uint64_t odd = uint64_t(0) - (q & 1);
+  const uint64_t sign = (q & 2) << 62;
+  return Double(((Bits(v.sin) & ~odd) | (Bits(v.cos) & odd)) ^ sign);
+}
+
+static inline float Rotate(const Quadrant<float, uint32_t> &v, uint32_t q) {
+  const uint32_t odd = uint32_t(0) - (q & 1);
+  const uint32_t sign = (q & 2) << 30;
+  return Float(((Bits(v.sin) & ~odd) | (Bits(v.cos) & odd)) ^ sign);
+}
+
+static inline double Sin(double x) {
+  auto v = SinCos(x);
+  // keeps the sign of -0
+  return x == 0 ? x : Rotate(v, v.q);
+}
+
+static inline float Sin(float x) {
+  auto v = SinCos(x);
+  return x == 0 ? x : Rotate(v, v.q);
+}
+
+static inline double Cos(double x) {
+  auto v = SinCos(x);
+  return Rotate(v, v.q + 1);
+}
+
+static inline float Cos(float x) {
+  auto v = SinCos(x);
+  return Rotate(v, v.q + 1);
+}
+
+static inline double Exp(double x) {
+  const double kd = x * 1.44269504088896338700e+00 + roundDouble;
+  const double k = kd - roundDouble;
+  const double hi = x - k * 6.93147180369123816490e-01;
+  const double lo = k * 1.90821492927058770002e-10;
+  const double r = hi - lo;
+  const double z = r * r;
+  const double c = r - z * (1.66666666666666019037e-01 +
+                            z * (-2.77777777770155933842e-03 +
+                                 z * (6.61375632143793436117e-05 +
+                                      z * (-1.65339022054652515390e-06 + z * 4.13813679705723846039e-08))));
+  const double y = 1.0 - ((lo - (r * c) / (2.0 - c)) - hi);
+  // 2^(k - 1) so that k = 1024 does not overflow
+  const double scale = Double((Bits(kd) + 1022) << 52);
+  const double result = (y + y) * scale;
+  return x > 7.09782712893383973096e+02 ? HUGE_VAL : x < -708.0 ? 0.0 : result;
+}
+
+static inline float Exp(float x) {
+  const float kd = x * 1.44269504088896341f + roundFloat;
+  const float k = kd - roundFloat;
+  const float r = (x - k * 0.693359375f) - k * -2.12194440e-4f;
+  const float y =
+    ((((((1.9875691500e-4f * r + 1.3981999507e-3f) * r + 8.3334519073e-3f) * r + 4.1665795894e-2f) * r +
+       1.6666665459e-1f) *
+        r +
+      5.0000001201e-1f) *
+       r * r +
+     r) +
+    1.0f;
+  const float scale = Float((Bits(kd) + 126) << 23);
+  const float result = (y + y) * scale;
+  return x > 88.72283905206835f ? HUGE_VALF : x < -86.5f ? 0.0f : result;
+}
+
+static inline double Log(double x) {
+  // subnormals are scaled by 2^54
+  const bool subnormal = x < 2.2250738585072014e-308;
+  const uint64_t u = Bits(subnormal ? x * 18014398509481984.0 : x);
+  // the mantissa is brought into [sqrt(2)/2, sqrt(2))
+  uint32_t hx = static_cast<uint32_t>(u >> 32) + (0x3ff00000 - 0x3fe6a09e);
+  const int32_t k = static_cast<int32_t>(hx >> 20) - 0x3ff - (subnormal ? 54 : 0);
+  hx = (hx & 0x000fffff) + 0x3fe6a09e;
+  const double f = Double((static_cast<uint64_t>(hx) << 32) | (u & 0xffffffff)) - 1.0;
+
+  const double hfsq = 0.5 * f * f;
+  const double s = f / (2.0 + f);
+  const double z = s * s;
+  const double w = z * z;
+  const double t1 = w * (3.999999999940941908e-01 + w * (2.222219843214978396e-01 + w * 1.531383769920937332e-01));
+  const double t2 =
+    z * (6.666666666666735130e-01 +
+         w * (2.857142874366239149e-01 + w * (1.818357216161805012e-01 + w * 1.479819860511658591e-01)));
+  const double dk = k;
+  const double result =
+    s * (hfsq + t2 + t1) + dk * 1.90821492927058770002e-10 - hfsq + f + dk * 6.93147180369123816490e-01;
+
+  return x > 0 ? (x == HUGE_VAL ? x : result) : x == 0 ? -HUGE_VAL : NAN;
+}
+
+static inline float Log(float x) {
+  const bool subnormal = x < 1.17549435e-38f;
+  uint32_t ix = Bits(subnormal ? x * 33554432.0f : x) + (0x3f800000 - 0x3f3504f3);
+  const int32_t k = static_cast<int32_t>(ix >> 23) - 0x7f - (subnormal ? 25 : 0);
+  ix = (ix & 0x007fffff) + 0x3f3504f3;
+  const float f = Float(ix) - 1.0f;
+
+  const float s = f / (2.0f + f);
+  const float z = s * s;
+  const float w = z * z;
+  const float t1 = w * (0.40000972152f + w * 0.24279078841f);
+  const float t2 = z * (0.66666662693f + w * 0.28498786688f);
+  const float hfsq = 0.5f * f * f;
+  const float dk = static_cast<float>(k);
+  const float result = s * (hfsq + t2 + t1) + dk * 9.0580006145e-06f - hfsq + f + dk * 6.9313812256e-01f;
+
+  return x > 0 ? (x == HUGE_VALF ? x : result) : x == 0 ? -HUGE_VALF : NAN;
+}
+
+// The integer types are computed in double precision like the std:: functions
+template <typename T> static inline double Sin(T x) {
+  return Sin(static_cast<double>(x));
+}
+
+template <typename T> static inline double Cos(T x) {
+  return Cos(static_cast<double>(x));
+}
+
+template <typename T> static inline double Exp(T x) {
+  return Exp(static_cast<double>(x));
+}
+
+template <typename T> static inline double Log(T x) {
+  return Log(static_cast<double>(x));
+}
+
+}; // namespace fast
+
+}; // namespace jeetah
@@ -1,8 +1,13 @@
 #include "types.h"
 #include "jeetah.h"
+#include "kernel.h"
+#include "builtins.h"
+#include "cpu.h"
+#include "fastmath.h"
 #include <cmath>
 #include <functional>
 #include <map>
+#include <vector>
 
 namespace jeetah {
 
@@ -29,31 +34,80 @@ static std::map<std::string, void *> builtins = {
   {"atan", reinterpret_cast<void *>(static_cast<T (*)(T)>(std::atan))},
   {"atanh", reinterpret_cast<void *>(static_cast<T (*)(T)>(std::atanh))},
   {"atan2", reinterpret_cast<void *>(static_cast<T (*)(T, T)>(std::atan2))},
+  {"fmod", reinterpret_cast<void *>(static_cast<T (*)(T, T)>(std::fmod))},
   {"ceil", reinterpret_cast<void *>(static_cast<T (*)(T)>(std::ceil))},
   {"floor", reinterpret_cast<void *>(static_cast<T (*)(T)>(std::floor))},
-  {"round", reinterpret_cast<void *>(static_cast<T (*)(T)>(std::round))},
-  {"trunc", reinterpret_cast<void *>(static_cast<T (*)(T)>(std::trunc))}};
+  {"round", reinterpret_cast<void *>(static_cast<T (*)(T)>(JSRound<T>))},
+  {"trunc", reinterpret_cast<void *>(static_cast<T (*)(T)>(std::trunc))},
+  {"fast_sin", reinterpret_cast<void *>(static_cast<T (*)(T)>(fast::Sin))},
+  {"fast_cos", reinterpret_cast<void *>(static_cast<T (*)(T)>(fast::Cos))},
+  {"fast_exp", reinterpret_cast<void *>(static_cast<T (*)(T)>(fast::Exp))},
+  {"fast_log", reinterpret_cast<void *>(static_cast<T (*)(T)>(fast::Log))}};
 
 template <> std::map<std::string, void*> builtins<uint32_t> = {};
 template <> std::map<std::string, void *> builtins<int32_t> = {};
 
+// V8 does not see the memory held by MIR, these are the footprints reported
+// to the GC so that it does not defer collecting us. Measured with mallinfo2()
+// on x86-64 Linux: MIR_init() and MIR_gen_init() with the builtins loaded
+// allocate 350 KB, a loaded and generated module keeps 5 to 28 bytes of heap
+// per byte of its MIR text, 16 on average for the eval() and map() modules of
+// six typical expressions. The machine code pages are not counted.
+static const int64_t contextMemory = 350 * 1024;
+static const int64_t mirTextMemoryRatio = 16;
+
+// Every length gets its own unrolled kernel
+static const size_t maxFixedLength = 4096;
+
+// MIR cannot unload a module, past this many lengths mapFixed() runs the generic map
+static const size_t maxFixedKernels = 8;
+
 template <typename T>
 Jeetah<T>::Jeetah(const Napi::CallbackInfo &info)
-  : Napi::ObjectWrap<Jeetah<T>>::ObjectWrap(info), evalFunc(nullptr), mapFunc(nullptr) {
+  : Napi::ObjectWrap<Jeetah<T>>::ObjectWrap(info), externalMemory(0), evalFunc(nullptr), mapFunc(nullptr) {
   Napi::Env env = info.Env();
   if (info.Length() < 1 || !info[0].IsFunction()) { throw Napi::TypeError::New(env, "No function argument"); }
 
   jsFn = Napi::Persistent(info[0].As<Napi::Function>());
+  if (info.Length() > 1 && !info[1].IsUndefined()) {
+    if (!info[1].IsObject()) throw Napi::TypeError::New(env, "Options must be an object");
+    options = Napi::Persistent(info[1].As<Napi::Object>());
+  } else {
+    options = Napi::Persistent(Napi::Object::New(env));
+  }
 
   ctx = MIR_init();
   MIR_gen_init(ctx, 0);
   MIR_gen_set_optimize_level(ctx, 0, 3);
   for (auto const &symbol : builtins<T>) { MIR_load_external(ctx, symbol.first.c_str(), symbol.second); }
+
+  externalMemory = contextMemory;
+  Napi::MemoryManagement::AdjustExternalMemory(env, externalMemory);
 }
 
 template <typename T> Jeetah<T>::~Jeetah() {
+  Release(this->Env());
+}
+
+template <typename T> void Jeetah<T>::Release(Napi::Env env) {
+  if (ctx == nullptr) return;
+
   MIR_gen_finish(ctx);
   MIR_finish(ctx);
+  ctx = nullptr;
+  evalFunc = nullptr;
+  mapFunc = nullptr;
+  vectorMap.reset();
+  fixedMapFuncs.clear();
+  jsFn.Reset();
+  options.Reset();
+
+  Napi::MemoryManagement::AdjustExternalMemory(env, -externalMemory);
+  externalMemory = 0;
+}
+
+template <typename T> void Jeetah<T>::CheckDisposed(Napi::Env env) {
+  if (ctx == nullptr) throw Napi::Error::New(env, "Expression has been disposed");
 }
 
 template <typename T> typename Jeetah<T>::JITFn Jeetah<T>::AssemblyAndLink(Napi::Env env, Napi::Value object) {
@@ -62,7 +116,8 @@ template <typename T> typename Jeetah<T>::JITFn Jeetah<T>::AssemblyAndLink(Napi:
   std::string nameModule = "m_" + object.ToObject().Get("name").ToString().Utf8Value();
   arguments = object.ToObject().Get("params").ToObject().GetPropertyNames().Length();
 
-  MIR_scan_string(ctx, object.ToObject().Get("mirText").ToString().Utf8Value().c_str());
+  std::string mirText = object.ToObject().Get("mirText").ToString().Utf8Value();
+  MIR_scan_string(ctx, mirText.c_str());
   MIR_module_t module = nullptr;
   for (MIR_module_t m = DLIST_HEAD(MIR_module_t, *MIR_get_module_list(ctx)); m != nullptr;
        m = DLIST_NEXT(MIR_module_t, m))
@@ -82,15 +137,68 @@ template <typename T> typename Jeetah<T>::JITFn Jeetah<T>::AssemblyAndLink(Napi:
 
   MIR_load_module(ctx, module);
   MIR_link(ctx, MIR_set_gen_interface, nullptr);
-  return reinterpret_cast<JITFn>(MIR_gen(ctx, 0, text));
+  JITFn fn = reinterpret_cast<JITFn>(MIR_gen(ctx, 0, text));
+
+  int64_t moduleMemory = static_cast<int64_t>(mirText.size()) * mirTextMemoryRatio;
+  externalMemory += moduleMemory;
+  Napi::MemoryManagement::AdjustExternalMemory(env, moduleMemory);
+
+  return fn;
+}
+
+template <typename T> typename Jeetah<T>::JITFn Jeetah<T>::GetMapFunc(Napi::Env env, Napi::Value iter) {
+  if (mapFunc == nullptr) {
+    Napi::Function compile = GetJSRoutine(env, "compileMap");
+    Napi::Value object =
+      compile({jsFn.Value(), Napi::String::New(env, NapiArrayType<T>::name), iter, options.Value()});
+    mapFunc = AssemblyAndLink(env, object);
+  }
+  return mapFunc;
+}
+
+// Straight-line expressions run as vector programs, everything else is compiled by MIR
+template <typename T> void Jeetah<T>::PrepareMap(Napi::Env env, Napi::Value iter) {
+  if (vectorMap || mapFunc != nullptr) return;
+
+  Napi::Function compile = GetJSRoutine(env, "compileVector");
+  Napi::Value program =
+    compile({jsFn.Value(), Napi::String::New(env, NapiArrayType<T>::name), iter, options.Value()});
+  if (!program.IsObject()) {
+    GetMapFunc(env, iter);
+    return;
+  }
+
+  vectorMap.reset(new VectorProgram<T>(env, program.ToObject()));
+  int64_t programMemory = static_cast<int64_t>(vectorMap->MemorySize());
+  externalMemory += programMemory;
+  Napi::MemoryManagement::AdjustExternalMemory(env, programMemory);
+}
+
+template <typename T>
+typename Jeetah<T>::JITFn Jeetah<T>::GetFixedMapFunc(Napi::Env env, Napi::Value iter, size_t len) {
+  auto cached = fixedMapFuncs.find(len);
+  if (cached != fixedMapFuncs.end()) return cached->second;
+  if (fixedMapFuncs.size() >= maxFixedKernels) return nullptr;
+
+  Napi::Function compile = GetJSRoutine(env, "compileMap");
+  Napi::Value object = compile(
+    {jsFn.Value(),
+     Napi::String::New(env, NapiArrayType<T>::name),
+     iter,
+     options.Value(),
+     Napi::Number::New(env, static_cast<double>(len))});
+  JITFn fn = AssemblyAndLink(env, object);
+  fixedMapFuncs[len] = fn;
+  return fn;
 }
 
 template <typename T> Napi::Value Jeetah<T>::Eval(const Napi::CallbackInfo &info) {
   Napi::Env env = info.Env();
+  CheckDisposed(env);
 
   if (evalFunc == nullptr) {
     Napi::Function compile = GetJSRoutine(env, "compile");
-    Napi::Value object = compile({jsFn.Value(), Napi::String::New(env, NapiArrayType<T>::name)});
+    Napi::Value object = compile({jsFn.Value(), Napi::String::New(env, NapiArrayType<T>::name), options.Value()});
     evalFunc = AssemblyAndLink(env, object);
   }
 
@@ -122,7 +230,16 @@ template <typename T> Napi::Value Jeetah<T>::Eval(const Napi::CallbackInfo &info
 }
 
 template <typename T> Napi::Value Jeetah<T>::Map(const Napi::CallbackInfo &info) {
+  return MapImpl(info, false);
+}
+
+template <typename T> Napi::Value Jeetah<T>::MapFixed(const Napi::CallbackInfo &info) {
+  return MapImpl(info, true);
+}
+
+template <typename T> Napi::Value Jeetah<T>::MapImpl(const Napi::CallbackInfo &info, bool fixed) {
   Napi::Env env = info.Env();
+  CheckDisposed(env);
   Napi::TypedArray input = info[0].As<Napi::TypedArray>();
   const size_t args = info.Length();
 
@@ -131,44 +248,128 @@ template <typename T> Napi::Value Jeetah<T>::Map(const Napi::CallbackInfo &info)
 
   if (args < 2 || !info[1].IsString()) throw Napi::TypeError::New(env, "Missing mandatory iterator argument");
 
-  if (mapFunc == nullptr) {
-    Napi::Function compile = GetJSRoutine(env, "compileMap");
-    Napi::Value object = compile({jsFn.Value(), Napi::String::New(env, NapiArrayType<T>::name), info[1]});
-    mapFunc = AssemblyAndLink(env, object);
-  }
-
   size_t len = input.ElementLength();
+  if (fixed && len > maxFixedLength)
+    throw Napi::RangeError::New(env, "Fixed length kernels are limited to " + std::to_string(maxFixedLength));
+
+  JITFn fn = nullptr;
+  if (fixed && len > 0) fn = GetFixedMapFunc(env, info[1], len);
+  const bool generic = !fixed || (len > 0 && fn == nullptr);
+  if (generic) PrepareMap(env, info[1]);
+
   T *source = GetTypedArrayPtr<T>(input);
 
+  // an undefined target is a missing one
   Napi::TypedArray result;
-  if (args < 3) {
+  if (args < 3 || info[2].IsUndefined()) {
     result = NapiArrayType<T>::New(env, len);
   } else {
     result = info[2].As<Napi::TypedArray>();
     if (!result.IsTypedArray() || result.TypedArrayType() != NapiArrayType<T>::type)
       throw Napi::TypeError::New(env, "Target array does not expression type");
+    if (result.ElementLength() < len) throw Napi::RangeError::New(env, "Target array is too small");
   }
   T *target = GetTypedArrayPtr<T>(result);
+  if (PartialOverlap(source, target, len))
+    throw Napi::RangeError::New(env, "Target array partially overlaps the input array");
 
-  mapFunc(source, target, len);
+  if (generic)
+    RunMap(source, target, len);
+  else if (fn != nullptr)
+    fn(source, target, len);
 
   return result;
 }
 
-template <typename T> Napi::Value Jeetah<T>::MapPrint(const Napi::CallbackInfo &info) {
+template <typename T> Napi::Value Jeetah<T>::MapMany(const Napi::CallbackInfo &info) {
   Napi::Env env = info.Env();
+  CheckDisposed(env);
+  const size_t args = info.Length();
 
-  if (mapFunc == nullptr) {
-    Napi::Function compile = GetJSRoutine(env, "compileMap");
-    Napi::Value object = compile({jsFn.Value(), Napi::String::New(env, NapiArrayType<T>::name), info[1]});
-    mapFunc = AssemblyAndLink(env, object);
+  if (args < 1 || !info[0].IsArray()) throw Napi::TypeError::New(env, "Missing mandatory Array of TypedArrays argument");
+  if (args < 2 || !info[1].IsString()) throw Napi::TypeError::New(env, "Missing mandatory iterator argument");
+
+  Napi::Array inputs = info[0].As<Napi::Array>();
+  const uint32_t n = inputs.Length();
+
+  Napi::Array results;
+  if (args < 3 || info[2].IsUndefined()) {
+    results = Napi::Array::New(env, n);
+  } else {
+    if (!info[2].IsArray()) throw Napi::TypeError::New(env, "Target is not an Array of TypedArrays");
+    results = info[2].As<Napi::Array>();
+    if (results.Length() != n) throw Napi::RangeError::New(env, "Target arrays do not match the input arrays");
   }
 
+  PrepareMap(env, info[1]);
+
+  // Validate everything before running anything
+  struct Segment {
+    T *source;
+    T *target;
+    size_t len;
+  };
+  std::vector<Segment> segments;
+  segments.reserve(n);
+  for (uint32_t i = 0; i < n; i++) {
+    Napi::Value in = inputs.Get(i);
+    if (!in.IsTypedArray() || in.As<Napi::TypedArray>().TypedArrayType() != NapiArrayType<T>::type)
+      throw Napi::TypeError::New(env, "Input element " + std::to_string(i) + " is not a TypedArray of the expression type");
+    Napi::TypedArray input = in.As<Napi::TypedArray>();
+    size_t len = input.ElementLength();
+
+    Napi::TypedArray result;
+    if (args < 3) {
+      result = NapiArrayType<T>::New(env, len);
+      results.Set(i, result);
+    } else {
+      Napi::Value out = results.Get(i);
+      if (!out.IsTypedArray() || out.As<Napi::TypedArray>().TypedArrayType() != NapiArrayType<T>::type)
+        throw Napi::TypeError::New(env, "Target element " + std::to_string(i) + " is not a TypedArray of the expression type");
+      result = out.As<Napi::TypedArray>();
+      if (result.ElementLength() < len)
+        throw Napi::RangeError::New(env, "Target element " + std::to_string(i) + " is too small");
+    }
+
+    Segment segment = {GetTypedArrayPtr<T>(input), GetTypedArrayPtr<T>(result), len};
+    if (PartialOverlap(segment.source, segment.target, len))
+      throw Napi::RangeError::New(env, "Target element " + std::to_string(i) + " partially overlaps its input");
+    segments.push_back(segment);
+  }
+
+  for (auto const &segment : segments) RunMap(segment.source, segment.target, segment.len);
+
+  return results;
+}
+
+template <typename T> Napi::Value Jeetah<T>::MapPrint(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+  CheckDisposed(env);
+
+  GetMapFunc(env, info[1]);
+
   MIR_output(ctx, stdout);
   printf("%p\n", mapFunc);
   return env.Undefined();
 }
 
+template <typename T> Napi::Value Jeetah<T>::Bind(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+  CheckDisposed(env);
+  return Kernel<T>::New(info.This(), info[0], info[1], info[2]);
+}
+
+template <typename T> Napi::Value Jeetah<T>::GetFn(const Napi::CallbackInfo &info) {
+  if (IsDisposed()) return info.Env().Undefined();
+  return jsFn.Value();
+}
+
+template <typename T> Napi::Value Jeetah<T>::Dispose(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+  Release(env);
+  return env.Undefined();
+}
+
 template <typename T> Napi::Function Jeetah<T>::GetClass(Napi::Env env) {
   return Napi::ObjectWrap<Jeetah<T>>::DefineClass(
     env,
@@ -176,7 +377,12 @@ template <typename T> Napi::Function Jeetah<T>::GetClass(Napi::Env env) {
     {
       Napi::ObjectWrap<Jeetah<T>>::InstanceMethod("eval", &Jeetah::Eval),
       Napi::ObjectWrap<Jeetah<T>>::InstanceMethod("map", &Jeetah::Map),
+      Napi::ObjectWrap<Jeetah<T>>::InstanceMethod("mapMany", &Jeetah::MapMany),
+      Napi::ObjectWrap<Jeetah<T>>::InstanceMethod("mapFixed", &Jeetah::MapFixed),
       Napi::ObjectWrap<Jeetah<T>>::InstanceMethod("__mapPrint", &Jeetah::MapPrint),
+      Napi::ObjectWrap<Jeetah<T>>::InstanceMethod("bind", &Jeetah::Bind),
+      Napi::ObjectWrap<Jeetah<T>>::InstanceMethod("dispose", &Jeetah::Dispose),
+      Napi::ObjectWrap<Jeetah<T>>::InstanceAccessor("fn", &Jeetah::GetFn, nullptr),
     });
 }
 
@@ -188,11 +394,52 @@ template <typename T> Napi::Function Jeetah<T>::GetJSRoutine(Napi::Env env, cons
   return fn.As<Napi::Function>();
 }
 
+template class Jeetah<double>;
+template class Jeetah<float>;
+template class Jeetah<uint32_t>;
+template class Jeetah<int32_t>;
+
+// For diagnostics, what the addon detected and which vector kernels it chose
+static Napi::Object GetCpuFeatures(Napi::Env env) {
+  const CpuFeatures &cpu = DetectCpu();
+  Napi::Object features = Napi::Object::New(env);
+  features.Set("sse2", cpu.sse2);
+  features.Set("sse41", cpu.sse41);
+  features.Set("avx", cpu.avx);
+  features.Set("avx2", cpu.avx2);
+  features.Set("fma", cpu.fma);
+  features.Set("avx512f", cpu.avx512f);
+  features.Set("avx512dq", cpu.avx512dq);
+  features.Set("kernels", KernelsName());
+  features.Set("libmvec", SelectKernels<double>().vectorMath);
+  return features;
+}
+
 Napi::Object Init(Napi::Env env, Napi::Object exports) {
+  // the CPU is probed once, when the addon is loaded
+  SelectKernels<double>();
+  SelectKernels<float>();
+  SelectKernels<uint32_t>();
+  SelectKernels<int32_t>();
+
+  // the classes belong to this env, they are freed when it is torn down
+  KernelClasses *kernels = new KernelClasses;
+  Kernel<double>::Init(env, *kernels);
+  Kernel<float>::Init(env, *kernels);
+  Kernel<uint32_t>::Init(env, *kernels);
+  Kernel<int32_t>::Init(env, *kernels);
+  napi_status status = napi_set_instance_data(
+    env, kernels, [](napi_env, void *data, void *) { delete static_cast<KernelClasses *>(data); }, nullptr);
+  if (status != napi_ok) {
+    delete kernels;
+    throw Napi::Error::New(env, "Failed initializing the kernels");
+  }
+
   exports.Set(Napi::String::New(env, "Float64Expression"), Jeetah<double>::GetClass(env));
   exports.Set(Napi::String::New(env, "Float32Expression"), Jeetah<float>::GetClass(env));
   exports.Set(Napi::String::New(env, "Uint32Expression"), Jeetah<uint32_t>::GetClass(env));
   exports.Set(Napi::String::New(env, "Int32Expression"), Jeetah<int32_t>::GetClass(env));
+  exports.Set(Napi::String::New(env, "cpuFeatures"), GetCpuFeatures(env));
   return exports;
 }
 
@@ -3,6 +3,9 @@
 #include <mir-gen.h>
 #include <mir.h>
 #include <napi.h>
+#include <map>
+#include <memory>
+#include "vector.h"
 
 namespace jeetah {
 
@@ -16,20 +19,43 @@ class Jeetah : public Napi::ObjectWrap<Jeetah<T>> {
 
     Napi::Value Eval(const Napi::CallbackInfo &);
     Napi::Value Map(const Napi::CallbackInfo &);
+    Napi::Value MapMany(const Napi::CallbackInfo &);
+    Napi::Value MapFixed(const Napi::CallbackInfo &);
     Napi::Value MapPrint(const Napi::CallbackInfo &);
+    Napi::Value Bind(const Napi::CallbackInfo &);
+    Napi::Value Dispose(const Napi::CallbackInfo &);
+    Napi::Value GetFn(const Napi::CallbackInfo &);
 
     static Napi::Function GetClass(Napi::Env);
 
-  private:
     using JITFn = T (*)(...);
+    void PrepareMap(Napi::Env, Napi::Value);
+    inline void RunMap(T *source, T *target, size_t len) {
+      if (vectorMap) vectorMap->Run(source, target, len);
+      else mapFunc(source, target, len);
+    }
+    inline bool IsDisposed() const {
+      return ctx == nullptr;
+    }
+
+  private:
     static Napi::Function GetJSRoutine(Napi::Env, const char*);
     JITFn AssemblyAndLink(Napi::Env, Napi::Value);
+    JITFn GetMapFunc(Napi::Env, Napi::Value);
+    JITFn GetFixedMapFunc(Napi::Env, Napi::Value, size_t);
+    Napi::Value MapImpl(const Napi::CallbackInfo &, bool);
+    void CheckDisposed(Napi::Env);
+    void Release(Napi::Env);
 
     MIR_context_t ctx;
     Napi::FunctionReference jsFn;
+    Napi::ObjectReference options;
     size_t arguments;
+    int64_t externalMemory;
 
     JITFn evalFunc;
     JITFn mapFunc;
+    std::unique_ptr<VectorProgram<T>> vectorMap;
+    std::map<size_t, JITFn> fixedMapFuncs;
 };
 }; // namespace jeetah
\ No newline at end of file
@@ -0,0 +1,79 @@
+#include "types.h"
+#include "kernel.h"
+
+namespace jeetah {
+
+template <typename T>
+Kernel<T>::Kernel(const Napi::CallbackInfo &info)
+  : Napi::ObjectWrap<Kernel<T>>::ObjectWrap(info), parent(nullptr) {
+  Napi::Env env = info.Env();
+
+  if (info.Length() < 1 || !info[0].IsObject()) throw Napi::TypeError::New(env, "Missing expression");
+  Napi::Object expression = info[0].As<Napi::Object>();
+  parent = Jeetah<T>::Unwrap(expression);
+
+  Napi::TypedArray input = info[1].As<Napi::TypedArray>();
+  if (info.Length() < 2 || !input.IsTypedArray() || input.TypedArrayType() != NapiArrayType<T>::type)
+    throw Napi::TypeError::New(env, "Missing mandatory TypedArray argument");
+
+  if (info.Length() < 3 || !info[2].IsString())
+    throw Napi::TypeError::New(env, "Missing mandatory iterator argument");
+
+  Napi::TypedArray result = info[3].As<Napi::TypedArray>();
+  if (info.Length() < 4 || !result.IsTypedArray() || result.TypedArrayType() != NapiArrayType<T>::type)
+    throw Napi::TypeError::New(env, "Missing mandatory target TypedArray argument");
+
+  len = input.ElementLength();
+  if (result.ElementLength() < len) throw Napi::RangeError::New(env, "Target array is too small");
+  if (PartialOverlap(GetTypedArrayPtr<T>(input), GetTypedArrayPtr<T>(result), len))
+    throw Napi::RangeError::New(env, "Target array partially overlaps the input array");
+
+  parent->PrepareMap(env, info[2]);
+
+  // The arrays (and the expression holding the code) must live as long as we do
+  parentRef = Napi::Persistent(expression);
+  inputRef = Napi::Persistent(static_cast<Napi::Object>(input));
+  resultRef = Napi::Persistent(static_cast<Napi::Object>(result));
+}
+
+template <typename T> Napi::Value Kernel<T>::Run(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+  if (parent->IsDisposed()) throw Napi::Error::New(env, "Expression has been disposed");
+
+  // The buffers can be detached (transferred to a worker) or resized since the
+  // construction, a detached buffer has no data and a length of 0
+  Napi::TypedArray input = inputRef.Value().As<Napi::TypedArray>();
+  Napi::TypedArray result = resultRef.Value().As<Napi::TypedArray>();
+  if (input.ElementLength() < len || result.ElementLength() < len)
+    throw Napi::RangeError::New(env, "Array has been detached or shrunk");
+
+  parent->RunMap(GetTypedArrayPtr<T>(input), GetTypedArrayPtr<T>(result), len);
+
+  return info.Env().Undefined();
+}
+
+template <typename T>
+Napi::Value Kernel<T>::New(Napi::Value expression, Napi::Value input, Napi::Value iter, Napi::Value result) {
+  Napi::Env env = expression.Env();
+  KernelClasses *classes = nullptr;
+  if (napi_get_instance_data(env, reinterpret_cast<void **>(&classes)) != napi_ok || classes == nullptr)
+    throw Napi::Error::New(env, "Jeetah kernels not initialized?");
+  return classes->constructors[NapiArrayType<T>::type].New({expression, input, iter, result});
+}
+
+template <typename T> void Kernel<T>::Init(Napi::Env env, KernelClasses &classes) {
+  Napi::Function ctor = Napi::ObjectWrap<Kernel<T>>::DefineClass(
+    env,
+    "JeetahKernel",
+    {
+      Napi::ObjectWrap<Kernel<T>>::InstanceMethod("run", &Kernel::Run),
+    });
+  classes.constructors[NapiArrayType<T>::type] = Napi::Persistent(ctor);
+}
+
+template class Kernel<double>;
+template class Kernel<float>;
+template class Kernel<uint32_t>;
+template class Kernel<int32_t>;
+
+}; // namespace jeetah
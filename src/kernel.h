@@ -0,0 +1,35 @@
+#pragma once
+
+#include <napi.h>
+#include <map>
+#include "jeetah.h"
+
+namespace jeetah {
+
+// The kernel classes of one env, the instance data of the addon:
+// each worker thread that loads it gets its own
+struct KernelClasses {
+  std::map<napi_typedarray_type, Napi::FunctionReference> constructors;
+};
+
+// A map() bound to a pair of arrays, all the validation is done once
+// at construction, run() only checks that the arrays are still there
+template <typename T>
+class Kernel : public Napi::ObjectWrap<Kernel<T>> {
+  public:
+    Kernel(const Napi::CallbackInfo &);
+
+    Napi::Value Run(const Napi::CallbackInfo &);
+
+    static void Init(Napi::Env, KernelClasses &);
+    static Napi::Value New(Napi::Value, Napi::Value, Napi::Value, Napi::Value);
+
+  private:
+    Jeetah<T> *parent;
+    Napi::ObjectReference parentRef;
+    Napi::ObjectReference inputRef;
+    Napi::ObjectReference resultRef;
+    size_t len;
+};
+
+}; // namespace jeetah
@@ -0,0 +1,5 @@
+// Built with -mavx2, only called when the CPU supports it
+#define JEETAH_ISA avx2
+#define JEETAH_VECTOR_ABI "d"
+#define JEETAH_VECTOR_BYTES 32
+#include "kernels-impl.h"
@@ -0,0 +1,5 @@
+// Built with -mavx512f -mavx512dq, only called when the CPU supports it
+#define JEETAH_ISA avx512
+#define JEETAH_VECTOR_ABI "e"
+#define JEETAH_VECTOR_BYTES 64
+#include "kernels-impl.h"
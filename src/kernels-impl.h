@@ -0,0 +1,216 @@
+#pragma once
+
+#include <type_traits>
+#include "builtins.h"
+#include "fastmath.h"
+#include "kernels.h"
+#include "libm.h"
+#include "shapes.h"
+
+// glibc has vector variants of sin, cos, exp, log and pow in libmvec
+#if defined(__linux__) && defined(JEETAH_X64) && defined(__GNUC__)
+#define JEETAH_LIBMVEC
+#include <cstdio>
+#include <dlfcn.h>
+#endif
+
+// Included by one translation unit per instruction set with JEETAH_ISA naming
+// the namespace. Everything here must have internal linkage or live in that
+// namespace - an inline function shared with the other translation units could
+// be linked from the copy built for a newer CPU. That is why there is no
+// std::copy() or std::map here and why the math comes from libm.h.
+namespace jeetah {
+namespace JEETAH_ISA {
+
+// JavaScript truthiness, NaN is false
+template <typename T> static inline bool Truthy(T v) {
+  return v != T(0) && v == v;
+}
+
+template <typename T, typename F> static inline void Unary(T *r, const T *a, size_t n, F f) {
+  for (size_t i = 0; i < n; i++) r[i] = f(a[i]);
+}
+
+// Constant operands are broadcast from a register instead of being loaded
+template <typename T, typename F>
+static inline void Binary(T *r, const T *a, const T *b, bool constA, bool constB, size_t n, F f) {
+  if (constB) {
+    const T k = b[0];
+    for (size_t i = 0; i < n; i++) r[i] = f(a[i], k);
+  } else if (constA) {
+    const T k = a[0];
+    for (size_t i = 0; i < n; i++) r[i] = f(k, b[i]);
+  } else {
+    for (size_t i = 0; i < n; i++) r[i] = f(a[i], b[i]);
+  }
+}
+
+#ifdef JEETAH_LIBMVEC
+// The vector types of the libmvec variants built for this instruction set
+template <typename T> struct Vector {
+  typedef T type __attribute__((vector_size(JEETAH_VECTOR_BYTES)));
+  static const size_t lanes = JEETAH_VECTOR_BYTES / sizeof(T);
+};
+
+template <typename T> struct VectorMath {
+  typedef typename Vector<T>::type V;
+  V (*sin)(V);
+  V (*cos)(V);
+  V (*exp)(V);
+  V (*log)(V);
+  V (*pow)(V, V);
+};
+
+// Loaded by GetKernels(), the block loops call the scalar functions when a variant is missing
+template <typename T> static VectorMath<T> vectorMath;
+
+// _ZGV<isa>N<lanes><arguments>_<function>, the float variants end with f
+template <typename F>
+static F VectorSymbol(void *libmvec, const char *fn, const char *args, size_t lanes, bool single) {
+  char symbol[32];
+  std::snprintf(symbol, sizeof(symbol), "_ZGV%sN%zu%s_%s%s", JEETAH_VECTOR_ABI, lanes, args, fn, single ? "f" : "");
+  return reinterpret_cast<F>(dlsym(libmvec, symbol));
+}
+
+// It is not always installed, musl has none
+template <typename T> static void LoadVectorMath(bool single) {
+  void *libmvec = dlopen("libmvec.so.1", RTLD_NOW | RTLD_LOCAL);
+  if (libmvec == nullptr) return;
+  typedef typename Vector<T>::type V;
+  const size_t lanes = Vector<T>::lanes;
+  vectorMath<T>.sin = VectorSymbol<V (*)(V)>(libmvec, "sin", "v", lanes, single);
+  vectorMath<T>.cos = VectorSymbol<V (*)(V)>(libmvec, "cos", "v", lanes, single);
+  vectorMath<T>.exp = VectorSymbol<V (*)(V)>(libmvec, "exp", "v", lanes, single);
+  vectorMath<T>.log = VectorSymbol<V (*)(V)>(libmvec, "log", "v", lanes, single);
+  vectorMath<T>.pow = VectorSymbol<V (*)(V, V)>(libmvec, "pow", "vv", lanes, single);
+}
+
+template <typename V> static inline V Apply(V (*f)(V), V x, V) {
+  return f(x);
+}
+
+template <typename V> static inline V Apply(V (*f)(V, V), V x, V y) {
+  return f(x, y);
+}
+
+// One call per vector of the block, the last partial vector is padded with zeros
+template <typename T, typename F> static inline bool VectorCall(F f, T *r, const T *a, const T *b, size_t n) {
+  if (f == nullptr) return false;
+  typedef typename Vector<T>::type V;
+  const size_t lanes = Vector<T>::lanes;
+  for (size_t i = 0; i < n; i += lanes) {
+    const size_t size = (n - i < lanes ? n - i : lanes) * sizeof(T);
+    V x = {}, y = {};
+    std::memcpy(&x, a + i, size);
+    if (b != nullptr) std::memcpy(&y, b + i, size);
+    V v = Apply(f, x, y);
+    std::memcpy(r + i, &v, size);
+  }
+  return true;
+}
+#else
+template <typename T> struct VectorMath {
+  void *sin, *cos, *exp, *log, *pow;
+};
+template <typename T> static VectorMath<T> vectorMath;
+template <typename T> static void LoadVectorMath(bool) {}
+template <typename T> static inline bool VectorCall(void *, T *, const T *, const T *, size_t) {
+  return false;
+}
+#endif
+
+template <typename T>
+static void Execute(op::Op insn, T *r, const T *a, const T *b, const T *c, bool ka, bool kb, size_t n) {
+  switch (insn) {
+    case op::Mov:
+      for (size_t i = 0; i < n; i++) r[i] = a[i];
+      break;
+    case op::Add: Binary(r, a, b, ka, kb, n, [](T x, T y) { return x + y; }); break;
+    case op::Sub: Binary(r, a, b, ka, kb, n, [](T x, T y) { return x - y; }); break;
+    case op::Mul: Binary(r, a, b, ka, kb, n, [](T x, T y) { return x * y; }); break;
+    case op::Div: Binary(r, a, b, ka, kb, n, [](T x, T y) { return x / y; }); break;
+    case op::Eq: Binary(r, a, b, ka, kb, n, [](T x, T y) { return x == y ? T(1) : T(0); }); break;
+    case op::Ne: Binary(r, a, b, ka, kb, n, [](T x, T y) { return x != y ? T(1) : T(0); }); break;
+    case op::Lt: Binary(r, a, b, ka, kb, n, [](T x, T y) { return x < y ? T(1) : T(0); }); break;
+    case op::Le: Binary(r, a, b, ka, kb, n, [](T x, T y) { return x <= y ? T(1) : T(0); }); break;
+    case op::Gt: Binary(r, a, b, ka, kb, n, [](T x, T y) { return x > y ? T(1) : T(0); }); break;
+    case op::Ge: Binary(r, a, b, ka, kb, n, [](T x, T y) { return x >= y ? T(1) : T(0); }); break;
+    case op::Neg:
+      for (size_t i = 0; i < n; i++) r[i] = -a[i];
+      break;
+    case op::Not:
+      for (size_t i = 0; i < n; i++) r[i] = Truthy(a[i]) ? T(0) : T(1);
+      break;
+    case op::Select:
+      for (size_t i = 0; i < n; i++) r[i] = Truthy(a[i]) ? b[i] : c[i];
+      break;
+    case op::Fma:
+      for (size_t i = 0; i < n; i++) r[i] = static_cast<T>(libm::fma(a[i], b[i], c[i]));
+      break;
+    case op::MulAdd:
+      // not contracted, the addon is built with -ffp-contract=off
+      for (size_t i = 0; i < n; i++) r[i] = a[i] * b[i] + c[i];
+      break;
+    case op::Sin: Unary(r, a, n, [](T x) -> T { return libm::sin(x); }); break;
+    case op::Cos: Unary(r, a, n, [](T x) -> T { return libm::cos(x); }); break;
+    case op::Sinh: Unary(r, a, n, [](T x) -> T { return libm::sinh(x); }); break;
+    case op::Cosh: Unary(r, a, n, [](T x) -> T { return libm::cosh(x); }); break;
+    case op::Tan: Unary(r, a, n, [](T x) -> T { return libm::tan(x); }); break;
+    case op::Tanh: Unary(r, a, n, [](T x) -> T { return libm::tanh(x); }); break;
+    case op::Sqrt: Unary(r, a, n, [](T x) -> T { return libm::sqrt(x); }); break;
+    case op::Exp: Unary(r, a, n, [](T x) -> T { return libm::exp(x); }); break;
+    case op::Log: Unary(r, a, n, [](T x) -> T { return libm::log(x); }); break;
+    case op::Log2: Unary(r, a, n, [](T x) -> T { return libm::log2(x); }); break;
+    case op::Log10: Unary(r, a, n, [](T x) -> T { return libm::log10(x); }); break;
+    case op::Abs: Unary(r, a, n, [](T x) -> T { return libm::fabs(x); }); break;
+    case op::Acos: Unary(r, a, n, [](T x) -> T { return libm::acos(x); }); break;
+    case op::Acosh: Unary(r, a, n, [](T x) -> T { return libm::acosh(x); }); break;
+    case op::Asin: Unary(r, a, n, [](T x) -> T { return libm::asin(x); }); break;
+    case op::Asinh: Unary(r, a, n, [](T x) -> T { return libm::asinh(x); }); break;
+    case op::Atan: Unary(r, a, n, [](T x) -> T { return libm::atan(x); }); break;
+    case op::Atanh: Unary(r, a, n, [](T x) -> T { return libm::atanh(x); }); break;
+    case op::Ceil: Unary(r, a, n, [](T x) -> T { return libm::ceil(x); }); break;
+    case op::Floor: Unary(r, a, n, [](T x) -> T { return libm::floor(x); }); break;
+    case op::Round: Unary(r, a, n, [](T x) -> T { return JSRound(x); }); break;
+    case op::Trunc: Unary(r, a, n, [](T x) -> T { return libm::trunc(x); }); break;
+    case op::Pow: Binary(r, a, b, ka, kb, n, [](T x, T y) -> T { return libm::pow(x, y); }); break;
+    case op::Atan2: Binary(r, a, b, ka, kb, n, [](T x, T y) -> T { return libm::atan2(x, y); }); break;
+    case op::Min: Binary(r, a, b, ka, kb, n, [](T x, T y) -> T { return JSMin(x, y); }); break;
+    case op::Max: Binary(r, a, b, ka, kb, n, [](T x, T y) -> T { return JSMax(x, y); }); break;
+    case op::FastSin: Unary(r, a, n, [](T x) -> T { return fast::Sin(x); }); break;
+    case op::FastCos: Unary(r, a, n, [](T x) -> T { return fast::Cos(x); }); break;
+    case op::FastExp: Unary(r, a, n, [](T x) -> T { return fast::Exp(x); }); break;
+    case op::FastLog: Unary(r, a, n, [](T x) -> T { return fast::Log(x); }); break;
+    case op::VectorSin:
+      if (!VectorCall<T>(vectorMath<T>.sin, r, a, nullptr, n)) Unary(r, a, n, [](T x) -> T { return libm::sin(x); });
+      break;
+    case op::VectorCos:
+      if (!VectorCall<T>(vectorMath<T>.cos, r, a, nullptr, n)) Unary(r, a, n, [](T x) -> T { return libm::cos(x); });
+      break;
+    case op::VectorExp:
+      if (!VectorCall<T>(vectorMath<T>.exp, r, a, nullptr, n)) Unary(r, a, n, [](T x) -> T { return libm::exp(x); });
+      break;
+    case op::VectorLog:
+      if (!VectorCall<T>(vectorMath<T>.log, r, a, nullptr, n)) Unary(r, a, n, [](T x) -> T { return libm::log(x); });
+      break;
+    case op::VectorPow:
+      // the constants fill their whole register
+      if (!VectorCall<T>(vectorMath<T>.pow, r, a, b, n))
+        Binary(r, a, b, ka, kb, n, [](T x, T y) -> T { return libm::pow(x, y); });
+      break;
+  }
+}
+
+template <typename T> Kernels<T> GetKernels() {
+  if (std::is_floating_point<T>::value) LoadVectorMath<T>(std::is_same<T, float>::value);
+  Kernels<T> kernels = {&Execute<T>, &FindShape<T>, vectorMath<T>.sin != nullptr};
+  return kernels;
+}
+
+template Kernels<double> GetKernels<double>();
+template Kernels<float> GetKernels<float>();
+template Kernels<uint32_t> GetKernels<uint32_t>();
+template Kernels<int32_t> GetKernels<int32_t>();
+
+}; // namespace JEETAH_ISA
+}; // namespace jeetah
@@ -0,0 +1,6 @@
+// The baseline build of the vector kernels
+#define JEETAH_ISA generic
+// the SSE2 variants of libmvec
+#define JEETAH_VECTOR_ABI "b"
+#define JEETAH_VECTOR_BYTES 16
+#include "kernels-impl.h"
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace jeetah {
+
+// The vector program instructions
+namespace op {
+enum Op {
+  Mov, Add, Sub, Mul, Div, Neg, Not, Eq, Ne, Lt, Le, Gt, Ge, Select,
+  // { fma: true }, MulAdd rounds twice like MIR on the CPUs without FMA3
+  Fma, MulAdd,
+  // Math builtins
+  Sin, Cos, Sinh, Cosh, Tan, Tanh, Sqrt, Pow, Exp, Log, Log2, Log10, Abs,
+  Acos, Acosh, Asin, Asinh, Atan, Atanh, Atan2, Ceil, Floor, Round, Trunc, Min, Max,
+  // { precision: 'fast' }
+  FastSin, FastCos, FastExp, FastLog,
+  // { precision: 'vector' }
+  VectorSin, VectorCos, VectorExp, VectorLog, VectorPow
+};
+}; // namespace op
+
+namespace shapes {
+static const size_t maxConstants = 4;
+}; // namespace shapes
+
+template <typename T> using ShapeFn = void (*)(const T *, T *, size_t, const T *);
+
+// The block loops are compiled once for every instruction set in
+// src/kernels*.cc and the best one for the CPU is selected at load time
+template <typename T> struct Kernels {
+  // r = op(a, b, c) over n elements, ka and kb are set when a or b is a broadcast constant
+  void (*execute)(op::Op, T *r, const T *a, const T *b, const T *c, bool ka, bool kb, size_t n);
+  ShapeFn<T> (*findShape)(const char *);
+  // set when the { precision: 'vector' } instructions call libmvec
+  bool vectorMath;
+};
+
+namespace generic {
+template <typename T> Kernels<T> GetKernels();
+}; // namespace generic
+
+#ifdef JEETAH_X64
+namespace avx2 {
+template <typename T> Kernels<T> GetKernels();
+}; // namespace avx2
+
+namespace avx512 {
+template <typename T> Kernels<T> GetKernels();
+}; // namespace avx512
+#endif
+
+template <typename T> const Kernels<T> &SelectKernels();
+
+}; // namespace jeetah
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <math.h>
+
+namespace jeetah {
+
+// The C library functions with internal linkage. The std:: overloads for
+// float and for the integers are inline functions of <cmath>: without
+// optimisation every translation unit emits a weak copy and the linker keeps
+// any one of them, possibly the one built for AVX-512 in src/kernels-avx512.cc.
+// The double functions and the float ones with an f suffix are not inline.
+namespace libm {
+
+#define JEETAH_LIBM_UNARY(name)                                                                                        \
+  static inline double name(double x) {                                                                                \
+    return ::name(x);                                                                                                  \
+  }                                                                                                                    \
+  static inline float name(float x) {                                                                                  \
+    return ::name##f(x);                                                                                               \
+  }                                                                                                                    \
+  template <typename T> static inline double name(T x) {                                                               \
+    return ::name(static_cast<double>(x));                                                                             \
+  }
+
+#define JEETAH_LIBM_BINARY(name)                                                                                       \
+  static inline double name(double x, double y) {                                                                      \
+    return ::name(x, y);                                                                                               \
+  }                                                                                                                    \
+  static inline float name(float x, float y) {                                                                         \
+    return ::name##f(x, y);                                                                                            \
+  }                                                                                                                    \
+  template <typename T> static inline double name(T x, T y) {                                                         \
+    return ::name(static_cast<double>(x), static_cast<double>(y));                                                     \
+  }
+
+JEETAH_LIBM_UNARY(sin)
+JEETAH_LIBM_UNARY(cos)
+JEETAH_LIBM_UNARY(sinh)
+JEETAH_LIBM_UNARY(cosh)
+JEETAH_LIBM_UNARY(tan)
+JEETAH_LIBM_UNARY(tanh)
+JEETAH_LIBM_UNARY(sqrt)
+JEETAH_LIBM_UNARY(exp)
+JEETAH_LIBM_UNARY(log)
+JEETAH_LIBM_UNARY(log2)
+JEETAH_LIBM_UNARY(log10)
+JEETAH_LIBM_UNARY(fabs)
+JEETAH_LIBM_UNARY(acos)
+JEETAH_LIBM_UNARY(acosh)
+JEETAH_LIBM_UNARY(asin)
+JEETAH_LIBM_UNARY(asinh)
+JEETAH_LIBM_UNARY(atan)
+JEETAH_LIBM_UNARY(atanh)
+JEETAH_LIBM_UNARY(ceil)
+JEETAH_LIBM_UNARY(floor)
+JEETAH_LIBM_UNARY(trunc)
+JEETAH_LIBM_BINARY(pow)
+JEETAH_LIBM_BINARY(atan2)
+JEETAH_LIBM_BINARY(copysign)
+
+#undef JEETAH_LIBM_UNARY
+#undef JEETAH_LIBM_BINARY
+
+static inline double fma(double x, double y, double z) {
+  return ::fma(x, y, z);
+}
+
+static inline float fma(float x, float y, float z) {
+  return ::fmaf(x, y, z);
+}
+
+template <typename T> static inline double fma(T x, T y, T z) {
+  return ::fma(static_cast<double>(x), static_cast<double>(y), static_cast<double>(z));
+}
+
+// std::signbit() is inline for double too
+static inline bool signbit(double x) {
+  return ::copysign(1.0, x) < 0;
+}
+
+static inline bool signbit(float x) {
+  return ::copysignf(1.0f, x) < 0;
+}
+
+template <typename T> static inline bool signbit(T x) {
+  return x < 0;
+}
+
+}; // namespace libm
+
+}; // namespace jeetah
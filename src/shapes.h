@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstring>
+#include "kernels.h"
+
+namespace jeetah {
+namespace JEETAH_ISA {
+
+// Precompiled kernels for the most common expression shapes,
+// the names must match the list in lib/compiler/shapes.ts
+namespace shapes {
+
+using jeetah::shapes::maxConstants;
+
+struct X {
+  template <typename T> static inline T Eval(T x, const T *) {
+    return x;
+  }
+};
+
+template <size_t I> struct K {
+  template <typename T> static inline T Eval(T, const T *k) {
+    return k[I];
+  }
+};
+
+template <typename A, typename B> struct Add {
+  template <typename T> static inline T Eval(T x, const T *k) {
+    return A::Eval(x, k) + B::Eval(x, k);
+  }
+};
+
+template <typename A, typename B> struct Sub {
+  template <typename T> static inline T Eval(T x, const T *k) {
+    return A::Eval(x, k) - B::Eval(x, k);
+  }
+};
+
+template <typename A, typename B> struct Mul {
+  template <typename T> static inline T Eval(T x, const T *k) {
+    return A::Eval(x, k) * B::Eval(x, k);
+  }
+};
+
+template <typename A, typename B> struct Div {
+  template <typename T> static inline T Eval(T x, const T *k) {
+    return A::Eval(x, k) / B::Eval(x, k);
+  }
+};
+
+// The constants are copied to locals so that the compiler
+// does not reload them after every store
+template <typename T, typename E> void Run(const T *source, T *target, size_t len, const T *constants) {
+  T k[maxConstants];
+  for (size_t i = 0; i < maxConstants; i++) k[i] = constants[i];
+  for (size_t i = 0; i < len; i++) target[i] = E::Eval(source[i], k);
+}
+
+}; // namespace shapes
+
+template <typename T> ShapeFn<T> FindShape(const char *name) {
+  using namespace shapes;
+  static const struct {
+    const char *name;
+    ShapeFn<T> fn;
+  } kernels[] = {
+    {"add(x,k)", &Run<T, Add<X, K<0>>>},
+    {"sub(x,k)", &Run<T, Sub<X, K<0>>>},
+    {"sub(k,x)", &Run<T, Sub<K<0>, X>>},
+    {"mul(x,k)", &Run<T, Mul<X, K<0>>>},
+    {"div(x,k)", &Run<T, Div<X, K<0>>>},
+    {"div(k,x)", &Run<T, Div<K<0>, X>>},
+    {"add(mul(x,k),k)", &Run<T, Add<Mul<X, K<0>>, K<1>>>},
+    {"sub(mul(x,k),k)", &Run<T, Sub<Mul<X, K<0>>, K<1>>>},
+    {"sub(k,mul(x,k))", &Run<T, Sub<K<0>, Mul<X, K<1>>>>},
+    {"mul(add(mul(x,k),k),k)", &Run<T, Mul<Add<Mul<X, K<0>>, K<1>>, K<2>>>},
+    {"mul(x,x)", &Run<T, Mul<X, X>>},
+    {"add(mul(x,x),k)", &Run<T, Add<Mul<X, X>, K<0>>>},
+    {"add(add(mul(x,k),mul(x,x)),k)", &Run<T, Add<Add<Mul<X, K<0>>, Mul<X, X>>, K<1>>>},
+    {"add(add(mul(mul(x,x),k),mul(x,k)),k)", &Run<T, Add<Add<Mul<Mul<X, X>, K<0>>, Mul<X, K<1>>>, K<2>>>},
+    {"add(add(mul(mul(x,k),x),mul(x,k)),k)", &Run<T, Add<Add<Mul<Mul<X, K<0>>, X>, Mul<X, K<1>>>, K<2>>>},
+    {"add(mul(add(x,k),x),k)", &Run<T, Add<Mul<Add<X, K<0>>, X>, K<1>>>},
+    {"add(mul(add(mul(x,k),k),x),k)", &Run<T, Add<Mul<Add<Mul<X, K<0>>, K<1>>, X>, K<2>>>},
+    {"add(mul(add(mul(add(x,k),x),k),x),k)", &Run<T, Add<Mul<Add<Mul<Add<X, K<0>>, X>, K<1>>, X>, K<2>>>},
+    {"add(mul(add(mul(add(mul(x,k),k),x),k),x),k)",
+     &Run<T, Add<Mul<Add<Mul<Add<Mul<X, K<0>>, K<1>>, X>, K<2>>, X>, K<3>>>},
+    {"div(mul(x,x),k)", &Run<T, Div<Mul<X, X>, K<0>>>},
+    {"sub(k,div(mul(x,x),k))", &Run<T, Sub<K<0>, Div<Mul<X, X>, K<1>>>>}};
+
+  for (auto const &kernel : kernels)
+    if (std::strcmp(kernel.name, name) == 0) return kernel.fn;
+  return nullptr;
+}
+
+}; // namespace JEETAH_ISA
+}; // namespace jeetah
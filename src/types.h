@@ -106,4 +106,13 @@ template <typename T> inline T *GetTypedArrayPtr(const Napi::TypedArray &array)
   return reinterpret_cast<T *>(reinterpret_cast<uint8_t *>(array.ArrayBuffer().Data()) + array.ByteOffset());
 }
 
+// The target can be the input array itself or a separate one, but not another
+// view that shares some of its elements: map() would read the elements it has
+// already overwritten, in an order that depends on how it runs
+template <typename T> inline bool PartialOverlap(const T *source, const T *target, size_t len) {
+  const uintptr_t s = reinterpret_cast<uintptr_t>(source);
+  const uintptr_t t = reinterpret_cast<uintptr_t>(target);
+  return s != t && t < s + len * sizeof(T) && s < t + len * sizeof(T);
+}
+
 } // namespace jeetah
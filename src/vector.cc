@@ -0,0 +1,162 @@
+#include "vector.h"
+#include "cpu.h"
+#include <algorithm>
+#include <map>
+#include <string>
+
+namespace jeetah {
+
+template <typename T> const size_t VectorProgram<T>::blockSize;
+
+template <typename T>
+VectorProgram<T>::VectorProgram(Napi::Env env, Napi::Object program) :
+    kernels(SelectKernels<T>()), shapeFn(nullptr), shapeConstants() {
+  static const std::map<std::string, op::Op> ops = {
+    {"mov", op::Mov},
+    {"add", op::Add},
+    {"sub", op::Sub},
+    {"mul", op::Mul},
+    {"div", op::Div},
+    {"neg", op::Neg},
+    {"not", op::Not},
+    {"eq", op::Eq},
+    {"ne", op::Ne},
+    {"lt", op::Lt},
+    {"le", op::Le},
+    {"gt", op::Gt},
+    {"ge", op::Ge},
+    {"select", op::Select},
+    {"fma", op::Fma},
+    {"sin", op::Sin},
+    {"cos", op::Cos},
+    {"sinh", op::Sinh},
+    {"cosh", op::Cosh},
+    {"tan", op::Tan},
+    {"tanh", op::Tanh},
+    {"sqrt", op::Sqrt},
+    {"pow", op::Pow},
+    {"exp", op::Exp},
+    {"log", op::Log},
+    {"log2", op::Log2},
+    {"log10", op::Log10},
+    {"abs", op::Abs},
+    {"acos", op::Acos},
+    {"acosh", op::Acosh},
+    {"asin", op::Asin},
+    {"asinh", op::Asinh},
+    {"atan", op::Atan},
+    {"atanh", op::Atanh},
+    {"atan2", op::Atan2},
+    {"ceil", op::Ceil},
+    {"floor", op::Floor},
+    {"round", op::Round},
+    {"trunc", op::Trunc},
+    {"min", op::Min},
+    {"max", op::Max},
+    {"fast_sin", op::FastSin},
+    {"fast_cos", op::FastCos},
+    {"fast_exp", op::FastExp},
+    {"fast_log", op::FastLog},
+    {"vector_sin", op::VectorSin},
+    {"vector_cos", op::VectorCos},
+    {"vector_exp", op::VectorExp},
+    {"vector_log", op::VectorLog},
+    {"vector_pow", op::VectorPow}};
+
+  const uint32_t count = program.Get("registers").ToNumber().Uint32Value();
+  result = program.Get("result").ToNumber().Uint32Value();
+  if (result == 0 || result >= count) throw Napi::Error::New(env, "Invalid vector program");
+
+  scratch.resize(count * blockSize);
+  registers.resize(count);
+  for (uint32_t r = 1; r < count; r++) registers[r] = scratch.data() + r * blockSize;
+
+  // The constants are filled once and never written
+  Napi::Array constants = program.Get("constants").As<Napi::Array>();
+  lastConstant = constants.Length();
+  for (uint32_t i = 0; i < constants.Length(); i++) {
+    Napi::Object c = constants.Get(i).ToObject();
+    uint32_t r = c.Get("register").ToNumber().Uint32Value();
+    if (r == 0 || r > lastConstant || r >= count) throw Napi::Error::New(env, "Invalid vector program");
+    std::fill(registers[r], registers[r] + blockSize, static_cast<T>(c.Get("value").ToNumber().DoubleValue()));
+  }
+
+  Napi::Array code = program.Get("text").As<Napi::Array>();
+  for (uint32_t i = 0; i < code.Length(); i++) {
+    Napi::Object insn = code.Get(i).ToObject();
+    // builtins are called once per block
+    std::string name = insn.Get("op").ToString().Utf8Value();
+    if (name == "call") name = insn.Get("fn").ToString().Utf8Value();
+    auto op = ops.find(name);
+    if (op == ops.end()) throw Napi::Error::New(env, "Invalid vector program");
+
+    // split like the fused multiply-adds of MIR when the CPU has no FMA3
+    const op::Op code = op->second == op::Fma && !DetectCpu().fma ? op::MulAdd : op->second;
+    Instruction instruction = {code, insn.Get("output").ToNumber().Uint32Value(), {0, 0, 0}};
+    Napi::Array input = insn.Get("input").As<Napi::Array>();
+    if (input.Length() > 3) throw Napi::Error::New(env, "Invalid vector program");
+    for (uint32_t j = 0; j < input.Length(); j++) instruction.input[j] = input.Get(j).ToNumber().Uint32Value();
+    if (instruction.output <= lastConstant || instruction.output >= count) throw Napi::Error::New(env, "Invalid vector program");
+    for (uint32_t j = 0; j < 3; j++)
+      if (instruction.input[j] >= count) throw Napi::Error::New(env, "Invalid vector program");
+
+    text.push_back(instruction);
+  }
+
+  Napi::Value shape = program.Get("shape");
+  if (shape.IsObject()) {
+    Napi::Array k = shape.ToObject().Get("constants").As<Napi::Array>();
+    if (k.Length() <= shapes::maxConstants) {
+      shapeFn = kernels.findShape(shape.ToObject().Get("name").ToString().Utf8Value().c_str());
+      for (uint32_t i = 0; i < k.Length(); i++) shapeConstants[i] = static_cast<T>(k.Get(i).ToNumber().DoubleValue());
+    }
+  }
+}
+
+template <typename T> size_t VectorProgram<T>::MemorySize() const {
+  return scratch.size() * sizeof(T) + text.size() * sizeof(Instruction);
+}
+
+template <typename T> void VectorProgram<T>::Execute(const Instruction &insn, size_t n) {
+  const bool ka = insn.input[0] > 0 && insn.input[0] <= lastConstant;
+  const bool kb = insn.input[1] > 0 && insn.input[1] <= lastConstant;
+  kernels.execute(
+    insn.op,
+    registers[insn.output],
+    registers[insn.input[0]],
+    registers[insn.input[1]],
+    registers[insn.input[2]],
+    ka,
+    kb,
+    n);
+}
+
+template <typename T> void VectorProgram<T>::Run(const T *source, T *target, size_t len) {
+  if (shapeFn != nullptr) {
+    shapeFn(source, target, len, shapeConstants);
+    return;
+  }
+
+  // The result block is produced in place when the arrays are separate, when
+  // the target is the input itself the instructions still read it until the
+  // end of the block. The callers reject the partially overlapping arrays.
+  const bool direct = target + len <= source || source + len <= target;
+  T *resultBlock = registers[result];
+
+  for (size_t base = 0; base < len; base += blockSize) {
+    const size_t n = std::min(blockSize, len - base);
+    registers[0] = const_cast<T *>(source + base);
+    registers[result] = direct ? target + base : resultBlock;
+    for (auto const &insn : text) Execute(insn, n);
+    if (!direct) std::copy(resultBlock, resultBlock + n, target + base);
+  }
+  registers[result] = resultBlock;
+}
+
+// The front-end produces vector programs only for the floating point types
+template class VectorProgram<double>;
+template class VectorProgram<float>;
+template class VectorProgram<uint32_t>;
+template class VectorProgram<int32_t>;
+
+}; // namespace jeetah
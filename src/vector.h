@@ -0,0 +1,44 @@
+#pragma once
+
+#include <napi.h>
+#include <vector>
+#include "kernels.h"
+
+namespace jeetah {
+
+// A straight-line expression executed over blocks of elements, every
+// instruction is a simple loop over the block that the C++ compiler
+// turns into packed SIMD, the last partial block is the scalar tail
+template <typename T> class VectorProgram {
+  public:
+    VectorProgram(Napi::Env, Napi::Object);
+
+    void Run(const T *, T *, size_t);
+    size_t MemorySize() const;
+
+    static const size_t blockSize = 256;
+
+  private:
+    struct Instruction {
+      op::Op op;
+      uint32_t output;
+      uint32_t input[3];
+    };
+
+    void Execute(const Instruction &, size_t);
+
+    // the block loops built for the instruction set of the CPU
+    const Kernels<T> &kernels;
+    std::vector<Instruction> text;
+    std::vector<T> scratch;
+    std::vector<T *> registers;
+    // registers 1 to lastConstant hold the constants
+    uint32_t lastConstant;
+    uint32_t result;
+
+    // set when the whole program matches a precompiled kernel
+    ShapeFn<T> shapeFn;
+    T shapeConstants[shapes::maxConstants];
+};
+
+}; // namespace jeetah
@@ -1,7 +1,7 @@
 import * as chai from 'chai';
 const assert = chai.assert;
 
-import { Float64Expression } from '../lib';
+import { Float64Expression, Float32Expression } from '../lib';
 
 function smartNumericalAssert(actual: number, expected: number): void {
     if (isNaN(expected))
@@ -97,4 +97,68 @@ describe('builtins', () => {
         assert.closeTo(m.eval(1, 1), fn(1, 1), 1e-9);
         assert.closeTo(m.eval(1, 0), fn(1, 0), 1e-9);
     });
+    it('inline builtins', () => {
+        const inputs = [-2.5, -1.5, -0.5, -0.4, -0, 0, 0.4, 0.49999999999999994, 0.5, 2.5,
+            4503599627370497, Infinity, -Infinity, NaN];
+        for (const fnName of ['sqrt', 'abs', 'ceil', 'floor', 'round', 'trunc']) {
+            const fn = new Function('x', `return Math.${fnName}(x)`) as (x: number) => number;
+            const m = new Float64Expression(fn);
+            for (const x of inputs)
+                assert.isTrue(Object.is(m.eval(x), fn(x)), `Math.${fnName}(${x})`);
+        }
+    });
+    it('Math.min / Math.max', () => {
+        const inputs = [-1, -0, 0, 2, NaN, Infinity];
+        for (const fnName of ['min', 'max']) {
+            const fn = new Function('x', 'y', `return Math.${fnName}(x, y)`) as (x: number, y: number) => number;
+            const m = new Float64Expression(fn);
+            for (const x of inputs)
+                for (const y of inputs)
+                    assert.isTrue(Object.is(m.eval(x, y), fn(x, y)), `Math.${fnName}(${x}, ${y})`);
+        }
+    });
+    it('Math.pow / ** with a constant exponent', () => {
+        const inputs = [-2.5, -1, -0, 0, 0.1, 3, 1e200, Infinity, -Infinity, NaN];
+        for (const n of [0, 1, 2, -1, 0.5]) {
+            for (const fn of [
+                new Function('x', `return Math.pow(x, ${n})`) as (x: number) => number,
+                new Function('x', `return x ** ${n}`) as (x: number) => number
+            ]) {
+                const m = new Float64Expression(fn);
+                for (const x of inputs)
+                    assert.isTrue(Object.is(m.eval(x), fn(x)), `${fn}(${x})`);
+            }
+        }
+        const fast = new Float64Expression((x: number) => x ** 5 - Math.pow(x, -3), { fastMath: true });
+        for (const x of [0.1, 1.5, 3])
+            assert.closeTo(fast.eval(x), x ** 5 - Math.pow(x, -3), 1e-12 * Math.abs(x ** 5 - Math.pow(x, -3)));
+        const assign = new Float64Expression((x: number) => {
+            let a = x + 1;
+            a **= 2;
+            return a;
+        });
+        assert.strictEqual(assign.eval(2), 9);
+    });
+    it('{ precision: \'fast\' }', () => {
+        const inputs = [-100, -3, -0.5, 0, 0.001, 1, 2, 3.7, 10, 100, 700];
+        for (const fnName of ['sin', 'cos', 'exp', 'log']) {
+            const fn = new Function('x', `return Math.${fnName}(x)`) as (x: number) => number;
+            const m64 = new Float64Expression(fn, { precision: 'fast' });
+            const m32 = new Float32Expression(fn, { precision: 'fast' });
+            for (const x of inputs) {
+                const expected = fn(x);
+                if (isNaN(expected) || !isFinite(expected)) {
+                    assert.isTrue(Object.is(m64.eval(x), expected), `Math.${fnName}(${x})`);
+                    continue;
+                }
+                assert.closeTo(m64.eval(x), expected, Math.abs(expected) * 1e-15 + 1e-300, `Math.${fnName}(${x})`);
+                if (Math.abs(expected) < 1e38)
+                    assert.closeTo(m32.eval(x), Math.fround(fn(Math.fround(x))), Math.abs(expected) * 5e-7 + 1e-38,
+                        `Math.${fnName}(${x})`);
+            }
+            const array = new Float64Array(inputs.filter((x) => x > 0));
+            const result = m64.map(array, 'x');
+            array.forEach((x, i) => assert.closeTo(result[i], fn(x), Math.abs(fn(x)) * 1e-15 + 1e-300));
+        }
+    });
 });
@@ -1,7 +1,7 @@
 import * as chai from 'chai';
 const assert = chai.assert;
 
-import { Float64Expression } from '../lib';
+import { Float64Expression, Int32Expression, Uint32Expression, compileBody, compile } from '../lib';
 
 describe('eval', () => {
     // eslint-disable-next-line @typescript-eslint/no-explicit-any
@@ -184,4 +184,258 @@ describe('eval', () => {
         assert.instanceOf(m, Float64Expression);
         assert.equal(m.eval(Math.PI / 2), fn(Math.PI / 2));
     });
+    it('{ fastMath: true } polynomials', () => {
+        const fns = [
+            (x: number): number => x * x * x * 2.5 + x * x * 1.5 - x * 3 + 7,
+            (x: number): number => Math.pow(x, 3) - 2 * Math.pow(x, 2) + x / 4 - 1,
+            (x: number): number => Math.sin(Math.pow(x + 1, 4)) + x
+        ];
+        for (const fn of fns) {
+            const m = new Float64Expression(fn, { fastMath: true });
+            for (const x of [-3, -0.5, 0, 0.1, 1, 2.5, 10])
+                assert.closeTo(m.eval(x), fn(x), Math.abs(fn(x)) * 1e-13 + 1e-13);
+        }
+        // the powers of sums are not expanded, near the root the expanded
+        // x^3 - 3000x^2 + 3e6x - 1e9 would be all rounding error
+        const root = (x: number): number => Math.pow(x - 1000, 3) + (x + 1) ** 16;
+        assert.notProperty(compileBody(root, 'Float64', { fastMath: true }).rewrites, 'horner');
+        const m = new Float64Expression(root, { fastMath: true });
+        for (const x of [1000.001, 999.9999])
+            assert.closeTo(m.eval(x), root(x), Math.abs(root(x)) * 1e-13);
+        const cube = (x: number): number => Math.pow(x - 1000, 3);
+        assert.closeTo(new Float64Expression(cube, { fastMath: true }).eval(1000.001), 1e-9, 1e-15);
+    });
+    it('{ fastMath: true } algebraic simplifications', () => {
+        const fns = [
+            (x: number): number => x / 0.5 + 1,
+            (x: number): number => Math.exp(Math.log(7 * x)),
+            (x: number): number => 2 * x * 3 / 4 + 1 - 0.5,
+            (x: number): number => x * 1 + 0
+        ];
+        for (const fn of fns) {
+            const m = new Float64Expression(fn, { fastMath: true });
+            for (const x of [0.1, 1, 2.5, 10])
+                assert.closeTo(m.eval(x), fn(x), Math.abs(fn(x)) * 1e-13);
+        }
+        const code = compileBody((x: number) => Math.exp(Math.log(7 * x)) / 2, 'Float64', { fastMath: true });
+        assert.deepEqual(code.rewrites, { 'exp-log': 1, reciprocal: 1, reassociation: 1 });
+        assert.isUndefined(compileBody((x: number) => x / 2, 'Float64').rewrites);
+    });
+    it('common subexpressions', () => {
+        const fn = (x: number): number => x > 1 ?
+            Math.sin(2.2 * x) + Math.cos(Math.PI / x) :
+            Math.sin(2.2 * x) - Math.cos(Math.PI / x) + Math.sin(2.2 * x);
+        const calls = (name: string) => (compile(fn, 'Float64').mirText as string)
+            .split('\n').filter((l) => l.includes(`call\t_p_${name}`)).length;
+        assert.equal(calls('sin'), 1);
+        assert.equal(calls('cos'), 1);
+        const m = new Float64Expression(fn);
+        for (const x of [-2, 0.5, 1, 3])
+            assert.equal(m.eval(x), fn(x));
+    });
+    it('copy propagation', () => {
+        const fn = (x: number): number => {
+            let a = x;
+            a += 1;
+            const b = a;
+            a *= 2;
+            return a * b + a;
+        };
+        const mir = compile(fn, 'Float64').mirText as string;
+        // no temporaries copied from the variables
+        assert.notMatch(mir, /dmov\t_expr_/);
+        const m = new Float64Expression(fn);
+        for (const x of [-2, 0.5, 3])
+            assert.equal(m.eval(x), fn(x));
+    });
+    it('conditions', () => {
+        const fn = (x: number): number => x >= 0 && !(x >= 5) ? Math.sqrt(x + 2) : x || -1;
+        // the comparisons branch without computing a boolean
+        assert.notInclude(compile(fn, 'Float64').mirText, 'i2d');
+        const m = new Float64Expression(fn);
+        for (const x of [-2, 0, 3, 5, 7, NaN])
+            assert.deepEqual(m.eval(x), fn(x));
+    });
+    it('branchless select', () => {
+        const fn = (x: number): number => !(x > 0) ? -x : x * 2;
+        assert.include(compile(fn, 'Float64').mirText, 'dsel');
+        assert.notInclude(compile(fn, 'Float64', { branchless: false }).mirText, 'dsel');
+        const expensive = (x: number): number => x > 0 ? Math.sqrt(x) : -x;
+        assert.notInclude(compile(expensive, 'Float64').mirText, 'dsel');
+        assert.include(compile(expensive, 'Float64', { branchless: true }).mirText, 'dsel');
+        const m = new Float64Expression(fn);
+        for (const x of [-2, 0, 3, NaN])
+            assert.deepEqual(m.eval(x), fn(x));
+        const clamp = function (x: number) { let r = x; if (x < 0) r = 0; return r; };
+        assert.include(compile(clamp, 'Int32').mirText, '\tsel\t');
+        const i = new Int32Expression(clamp);
+        assert.deepEqual([-3, 0, 4].map((x) => i.eval(x)), [0, 0, 4]);
+    });
+    it('integer division by constants', () => {
+        const fn = (x: number): number => x % 10 + x / -7;
+        assert.notMatch(compile(fn, 'Int32').mirText as string, /divs|mods/);
+        // the integer quotient is rounded towards zero
+        const i = new Int32Expression(fn);
+        for (const x of [-(2 ** 31), -100, -1, 0, 6, 2 ** 31 - 1])
+            assert.equal(i.eval(x), x % 10 + Math.trunc(x / -7));
+        const hash = (x: number): number => x % 1000 + x / 4294967295;
+        const u = new Uint32Expression(hash);
+        for (const x of [0, 999, 123456789, 2 ** 32 - 1])
+            assert.equal(u.eval(x), x % 1000 + Math.trunc(x / 4294967295));
+        const mod = new Float64Expression((x: number) => x % 2.5);
+        assert.equal(mod.eval(-7), -2);
+    });
+    it('integer division by zero and -1', () => {
+        // NaN and Infinity are 0 in an integer array, -2^31 / -1 wraps around
+        const mod = (x: number, y: number): number => x % y;
+        const div = (x: number, y: number): number => x / y;
+        const i = [new Int32Expression(mod), new Int32Expression(div)];
+        for (const [x, y] of [[7, 0], [-7, 0], [0, 0], [-(2 ** 31), -1], [-(2 ** 31), 0], [7, -1], [-7, 2]]) {
+            assert.equal(i[0].eval(x, y), mod(x, y) | 0);
+            assert.equal(i[1].eval(x, y), div(x, y) | 0);
+        }
+        const u = [new Uint32Expression(mod), new Uint32Expression(div)];
+        for (const [x, y] of [[7, 0], [0, 0], [2 ** 32 - 1, 0], [2 ** 32 - 1, 2 ** 32 - 1], [7, 2]]) {
+            assert.equal(u[0].eval(x, y), mod(x, y) >>> 0);
+            assert.equal(u[1].eval(x, y), div(x, y) >>> 0);
+        }
+        assert.equal(new Int32Expression((x: number) => 7 % x).eval(0), 0);
+    });
+    it('bitwise operators', () => {
+        const fn = (x: number, y: number): number => (x << 8 | y >>> 24) ^ ~(x & 0xff) + (y >> x);
+        const i = new Int32Expression(fn);
+        const u = new Uint32Expression(fn);
+        for (const [x, y] of [[0, 0], [1, -1], [-5, 2 ** 31 - 1], [33, 0x12345678], [255, -(2 ** 31)]]) {
+            assert.equal(i.eval(x, y), fn(x, y) | 0);
+            assert.equal(u.eval(x >>> 0, y >>> 0), fn(x >>> 0, y >>> 0) >>> 0);
+        }
+        assert.throws(() => compile((x: number) => x | 0, 'Float64'), /integer types/);
+    });
+    it('loops', () => {
+        const escape = function (x: number) {
+            let zr = 0, zi = 0, n = 0;
+            for (let i = 0; i < 50; i++) {
+                const t = zr * zr - zi * zi + x;
+                zi = 2 * zr * zi + x / 2;
+                zr = t;
+                if (zr * zr + zi * zi > 4) break;
+                n++;
+            }
+            return n;
+        };
+        // the counters are i64
+        assert.match(compile(escape, 'Float64').mirText as string, /\tblt\t_loop_\d+_body, i, 50/);
+        const m = new Float64Expression(escape);
+        const input = new Float64Array([-2, -0.5, 0, 0.2, 0.3, 1]);
+        assert.deepEqual(Array.from(m.map(input, 'x')), Array.from(input).map(escape));
+        const newton = function (x: number) {
+            let y = x;
+            do {
+                y = 0.5 * (y + x / y);
+            } while (Math.abs(y * y - x) > 1e-12 * x);
+            return y;
+        };
+        assert.closeTo(new Float64Expression(newton).eval(2), Math.SQRT2, 1e-12);
+        const popcount = function (x: number) {
+            let c = 0;
+            while (x) {
+                x &= x - 1;
+                c++;
+            }
+            return c;
+        };
+        const u = new Uint32Expression(popcount);
+        assert.deepEqual([0, 7, 2 ** 32 - 1].map((x) => u.eval(x)), [0, 3, 32]);
+        const labeled = function (x: number) {
+            let s = 0;
+            outer: for (let i = 0; i < 5; i++)
+                for (let j = 0; j < 5; j++) {
+                    if (j > i) continue outer;
+                    if (i * j > x) break outer;
+                    s += i + j;
+                }
+            return s;
+        };
+        const i = new Int32Expression(labeled);
+        for (const x of [0, 3, 100])
+            assert.equal(i.eval(x), labeled(x));
+        // the variables are scoped to the function
+        const shadow = function (x: number) {
+            let t = x;
+            for (let i = 0; i < 3; i++) {
+                const t = i * 2;
+                x += t;
+            }
+            return t + x;
+        };
+        assert.throws(() => compile(shadow, 'Float64'), SyntaxError, /t shadows/);
+        const siblings = function (x: number) {
+            for (let i = 0; i < 3; i++) x += i;
+            for (let i = 0; i < 2; i++) x *= 2;
+            return x;
+        };
+        assert.equal(new Float64Expression(siblings).eval(1), siblings(1));
+    });
+    it('switch', () => {
+        const landCover = function (code: number) {
+            switch (code) {
+                case 11: return 0.05;
+                case 12: return 0.8;
+                case 21:
+                case 22: return 0.15;
+                case 23: return 0.2;
+                case 24: return 0.25;
+                default: return -1;
+            }
+        };
+        // a jump table, the values that are not integers go to the default
+        assert.include(compile(landCover, 'Float64').mirText, '\tswitch\t');
+        const m = new Float64Expression(landCover);
+        for (const x of [10, 11, 12, 21, 22, 24, 25, 11.5, NaN])
+            assert.equal(m.eval(x), landCover(x));
+        const sparse = function (x: number) {
+            let r = x;
+            switch (x) {
+                case 1: r = 10; break;
+                case 1000: r = 20;
+                // falls through
+                case -7: r += 3; break;
+            }
+            return r;
+        };
+        assert.notInclude(compile(sparse, 'Int32').mirText, '\tswitch\t');
+        const i = new Int32Expression(sparse);
+        assert.deepEqual([1, 1000, -7, 5].map((x) => i.eval(x)), [1, 1000, -7, 5].map(sparse));
+    });
+    it('lookup tables', () => {
+        const weight = function (x: number) {
+            const c = [0.05, 0.8, 0.15, 0.2];
+            return c[x] * c.length;
+        };
+        // an index out of the table or that is not an integer reads NaN
+        const m = new Float64Expression(weight);
+        for (const x of [0, 1, 3, 4, -1, 1.5])
+            assert.deepEqual(m.eval(x), weight(x));
+        const bits = function (x: number) {
+            const c = [0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4];
+            return c[x & 15] + c[(x >>> 4) & 15];
+        };
+        const i = new Int32Expression(bits);
+        assert.deepEqual([0, 7, 255, 100].map((x) => i.eval(x)), [0, 7, 255, 100].map(bits));
+        assert.equal(new Int32Expression((x: number) => { const c = [1, 2]; return c[x]; }).eval(2), 0);
+        const empty = (x: number) => {
+            const c: number[] = [];
+            return c[x];
+        };
+        assert.throws(() => compile(empty, 'Float64'), SyntaxError, /empty/);
+    });
+    it('dispose', () => {
+        const m = new Float64Expression((x: number) => x * 2);
+        assert.equal(m.eval(2), 4);
+        m.dispose();
+        assert.throws(() => m.eval(2), /disposed/);
+        assert.throws(() => m.map(new Float64Array(4), 'x'), /disposed/);
+        // disposing twice is a no-op
+        m.dispose();
+    });
 });
@@ -1,7 +1,8 @@
 import * as chai from 'chai';
+import { MessageChannel } from 'worker_threads';
 const assert = chai.assert;
 
-import { Float64Expression } from '../lib';
+import { Float64Expression, Float32Expression, cpuFeatures } from '../lib';
 
 describe('map', () => {
     // eslint-disable-next-line @typescript-eslint/no-explicit-any
@@ -39,4 +40,210 @@ describe('map', () => {
         assert.instanceOf(r, Float64Array);
         assert.deepEqual(r, expected);
     });
+
+    it('bind', () => {
+        const fn = (x: number): number => x * 2 + 1;
+        const expected = new Float64Array(array.length);
+        array.map((v, i) => expected[i] = fn(v));
+
+        const m = new Float64Expression(fn);
+        const r = new Float64Array(array.length);
+        const k = m.bind(array, 'x', r);
+        k.run();
+        assert.deepEqual(r, expected);
+
+        r.fill(0);
+        k.run();
+        assert.deepEqual(r, expected);
+
+        assert.throws(() => m.bind(array, 'x', new Float64Array(2)), /too small/);
+        assert.throws(() => m.bind(array, 'x', new Float32Array(array.length)), /TypedArray/);
+
+        // transferring a buffer to another thread detaches it
+        const input = array.slice();
+        const k2 = m.bind(input, 'x', r);
+        const { port1 } = new MessageChannel();
+        port1.postMessage(input.buffer, [input.buffer]);
+        port1.close();
+        assert.throws(() => k2.run(), /detached/);
+
+        m.dispose();
+        assert.throws(() => k.run(), /disposed/);
+    });
+
+    it('mapMany', () => {
+        const fn = (x: number): number => x * x - 1;
+        const arrays = [array, array.subarray(3, 7), new Float64Array(0), new Float64Array([-1, 0.5])];
+
+        const m = new Float64Expression(fn);
+        const r = m.mapMany(arrays, 'x');
+        assert.lengthOf(r, arrays.length);
+        arrays.forEach((a, i) => assert.deepEqual(r[i], a.map(fn)));
+
+        const targets = arrays.map((a) => new Float64Array(a.length));
+        const r2 = m.mapMany(arrays, 'x', targets);
+        assert.strictEqual(r2, targets);
+        arrays.forEach((a, i) => assert.deepEqual(targets[i], a.map(fn)));
+
+        assert.throws(() => m.mapMany([array, new Float32Array(2)], 'x'), /element 1/);
+        assert.throws(() => m.mapMany([array], 'x', [new Float64Array(1)]), /too small/);
+    });
+
+    it('adaptiveMap', () => {
+        const fn = (x: number): number => Math.sin(x) * 2 + 1;
+        const m = new Float64Expression(fn);
+
+        for (const size of [0, 4, 16, 4096]) {
+            const input = new Float64Array(size).map((v, i) => i / 10);
+            const r = m.adaptiveMap(input, 'x');
+            assert.instanceOf(r, Float64Array);
+            assert.lengthOf(r, size);
+            r.forEach((v, i) => assert.closeTo(v, fn(input[i]), 1e-9));
+        }
+
+        assert.throws(() => m.adaptiveMap(new Float32Array(4), 'x'), /TypedArray/);
+        // V8 would compute a Float32 expression in double
+        assert.notProperty(new Float32Expression(fn), 'adaptiveMap');
+        // above the threshold it calls map() without a target
+        assert.deepEqual(m.map(array, 'x', undefined), array.map(fn));
+        assert.lengthOf(m.mapMany([array], 'x', undefined), 1);
+
+        m.dispose();
+        assert.throws(() => m.adaptiveMap(new Float64Array(4), 'x'), /disposed/);
+    });
+
+    it('mapFixed', () => {
+        const fn = function (x: number): number {
+            if (x > 10) return x * 2;
+            return x - 1;
+        };
+        const m = new Float64Expression(fn);
+
+        // more lengths than the cache of kernels holds
+        for (const size of [16, 5, 16, 0, 1, 2, 3, 4, 6, 7, 8, 9, 10, 11, 5]) {
+            const input = array.subarray(0, size);
+            const r = m.mapFixed(input, 'x');
+            assert.instanceOf(r, Float64Array);
+            assert.deepEqual(r, input.map(fn));
+        }
+
+        assert.throws(() => m.mapFixed(array, 'x', new Float64Array(4)), /too small/);
+    });
+
+    it('unroll', () => {
+        const fn = (x: number): number => 2.2 * x + 1.1;
+
+        for (const unroll of [undefined, 1, 2, 8]) {
+            const m = new Float64Expression(fn, { unroll });
+            for (const size of [0, 1, 7, 16]) {
+                const input = array.subarray(0, size);
+                assert.deepEqual(m.map(input, 'x'), input.map(fn));
+            }
+        }
+
+        assert.throws(() => new Float64Expression(fn, { unroll: 3 }).map(array, 'x'), /unroll factor/);
+    });
+
+    it('vectorize', () => {
+        const fns = [
+            (x: number): number => (2.2 * x + 1.1) * 3.3,
+            (x: number): number => x > 8 ? x * x : -x / 3,
+            (x: number): number => (x > 2 && x < 9) || x == 0 ? 1 : 0,
+            function (x: number): number {
+                const a = x * 2;
+                const b = a + x;
+                return b * a - 1;
+            }
+        ];
+
+        for (const fn of fns) {
+            const vector = new Float64Expression(fn);
+            const scalar = new Float64Expression(fn, { vectorize: false });
+            for (const size of [0, 1, 255, 256, 257, 1000]) {
+                const input = new Float64Array(size).map((v, i) => i % 17);
+                const expected = input.map(fn);
+                assert.deepEqual(vector.map(input, 'x'), expected);
+                assert.deepEqual(scalar.map(input, 'x'), expected);
+                // in place
+                vector.map(input, 'x', input);
+                assert.deepEqual(input, expected);
+            }
+        }
+
+        // another view of some of the same elements
+        const m = new Float64Expression(fns[0]);
+        const buffer = new Float64Array(1000);
+        const input = buffer.subarray(0, 400);
+        assert.throws(() => m.map(input, 'x', buffer.subarray(1, 401)), /partially overlaps/);
+        assert.throws(() => m.bind(input, 'x', buffer.subarray(300)), /partially overlaps/);
+        assert.throws(() => m.mapMany([input], 'x', [buffer.subarray(200, 600)]), /partially overlaps/);
+        assert.deepEqual(m.map(input, 'x', buffer.subarray(400, 800)), new Float64Array(400).map(fns[0]));
+    });
+
+    it('precompiled shapes', () => {
+        const fns = [
+            (x: number): number => 1.5 - x,
+            (x: number): number => 1.1 + x * 2.2,
+            (x: number): number => 3.3 * (2.2 * x + 1.1),
+            (x: number): number => x * x + 2 * x + 1,
+            (x: number): number => 1 - (x * x / 0.5)
+        ];
+        const input = new Float32Array(1000).map((v, i) => i / 7 - 50);
+
+        for (const fn of fns) {
+            const shape = new Float32Expression(fn);
+            const scalar = new Float32Expression(fn, { vectorize: false });
+            assert.deepEqual(shape.map(input, 'x'), scalar.map(input, 'x'));
+        }
+    });
+
+    it('block builtins', () => {
+        const fns = [
+            (x: number): number => Math.sin(2.2 * x) + Math.cos(Math.PI / x),
+            (x: number): number => Math.sqrt(Math.abs(x)) * Math.pow(x, 3),
+            (x: number): number => x > 0 ? Math.log(x) : Math.atan2(x, 2)
+        ];
+        const input = new Float64Array(1000).map((v, i) => i / 7 - 50);
+
+        for (const fn of fns) {
+            const vector = new Float64Expression(fn);
+            const scalar = new Float64Expression(fn, { vectorize: false });
+            assert.deepEqual(vector.map(input, 'x'), scalar.map(input, 'x'));
+        }
+
+        // libmvec is within 4 ULP of the exact functions
+        for (const fn of fns) {
+            const vector = new Float64Expression(fn, { precision: 'vector' }).map(input, 'x');
+            const exact = new Float64Expression(fn).map(input, 'x');
+            exact.forEach((v, i) => isNaN(v) ? assert.isNaN(vector[i]) :
+                assert.closeTo(vector[i], v, 1e-14 * Math.max(1, Math.abs(v))));
+        }
+
+        const round = new Float64Expression((x: number): number => Math.round(x));
+        const halves = new Float64Array([-2.5, -1.5, -0.5, -0.2, 0.5, 1.5, 2.5, 0.49999999999999994]);
+        assert.deepEqual(round.map(halves, 'x'), halves.map(Math.round));
+    });
+
+    it('{ fma: true }', () => {
+        const fns = [
+            (x: number): number => ((2.2 * x + 1.1) * x - 3.3) * x + 0.5,
+            (x: number): number => 1 - x * x / 3,
+            (x: number): number => x * x - x * x
+        ];
+        const input = new Float64Array(1000).map((v, i) => i / 7 - 50);
+
+        for (const fn of fns) {
+            const vector = new Float64Expression(fn, { fma: true });
+            const scalar = new Float64Expression(fn, { fma: true, vectorize: false });
+            const result = vector.map(input, 'x');
+            assert.deepEqual(result, scalar.map(input, 'x'));
+            result.forEach((v, i) => assert.closeTo(v, fn(input[i]), Math.abs(fn(input[i])) * 1e-13 + 1e-13));
+        }
+
+        // the rounding error of x * x is not lost when the CPU fuses, the vector program agrees either way
+        const error = new Float64Expression((x: number): number => x * x - x * x, { fma: true });
+        const fused = cpuFeatures.fma ? -8.326672684688674e-19 : 0;
+        assert.equal(error.eval(0.1), fused);
+        assert.deepEqual(error.map(new Float64Array(300).fill(0.1), 'x'), new Float64Array(300).fill(fused));
+    });
 });
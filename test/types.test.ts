@@ -80,4 +80,14 @@ describe('types', () => {
             }
         });
     }
+
+    it('cpuFeatures', () => {
+        const cpu = jeetah.cpuFeatures;
+        for (const f of ['sse2', 'sse41', 'avx', 'avx2', 'fma', 'avx512f', 'avx512dq', 'libmvec'])
+            assert.isBoolean((cpu as unknown as Record<string, boolean>)[f]);
+        assert.include(['generic', 'avx2', 'avx512'], cpu.kernels);
+        if (cpu.kernels === 'avx2') assert.isTrue(cpu.avx2);
+        if (cpu.kernels === 'avx512') assert.isTrue(cpu.avx512f && cpu.avx512dq);
+        if (cpu.avx2) assert.isTrue(cpu.avx);
+    });
 });